@@ -19,7 +19,7 @@ set ADDITIONAL_FLAGS=/DDEBUG /DTEST -DPLATFORM_GL_MAJOR_VERSION=3 -DPLATFORM_GL_
 set DISABLED_WARNINGS=/wd4100 /wd4189 /wd4996 /wd4505 /wd4201
 
 :: Compiler flags
-:: /std     use this version of c++
+:: /std     use this version of c++ (20 for designated initializers, see GameParams)
 :: /Oi		compiler intrinsics
 :: /GR- 	no runtime type info
 :: /EHa- 	turn off exception handling
@@ -34,7 +34,7 @@ set DISABLED_WARNINGS=/wd4100 /wd4189 /wd4996 /wd4505 /wd4201
 :: /I       Additional include directory
 :: /P       Preprocessor output to file
 set COMMON_COMPILER_FLAGS=/Oi /GR- /EHa- /nologo /W4 /MT /Gm- /Z7 /Fm %DISABLED_WARNINGS% /Fe%EXE_NAME% /I ..\game\include
-set CPP_FLAG=/std:c++17
+set CPP_FLAG=/std:c++20
 set C_FLAG=/std:c11
 set PLATFORM_COMPILER_FLAGS=/I %SDL_DIR%\include /I %STB_DIR% /I %IMGUI_DIR%\backends /I %IMGUI_DIR% /I %GLAD_DIR%\include
 set COMPILER_FLAGS=%COMMON_COMPILER_FLAGS% %PLATFORM_COMPILER_FLAGS%
@@ -50,7 +50,7 @@ set LINKER_FLAGS=%COMMON_LINKER_FLAGS% %PLATFORM_LINKER_FLAGS% /DEBUG:FULL
 
 set IMGUI_SOURCES=%IMGUI_DIR%\backends\imgui_impl_sdl.cpp %IMGUI_DIR%\backends\imgui_impl_opengl3.cpp %IMGUI_DIR%\imgui*.cpp
 set GAME_CPP_SOURCES=..\game\main.cpp ..\game\gui.cpp
-set GAME_C_SOURCES=..\game\windows.c ..\game\log.c ..\game\mem.c ..\game\render.c ..\game\game.c ..\game\file.c ..\game\draw.c
+set GAME_C_SOURCES=..\game\windows.c ..\game\log.c ..\game\mem.c ..\game\render.c ..\game\game.c ..\game\file.c ..\game\draw.c ..\game\engine.c ..\game\bitboard.c ..\game\boxsum.c ..\game\rng.c ..\game\solver.c ..\game\job.c ..\game\noguess.c ..\game\prob.c ..\game\replay.c
 
 :: Create build directory
 IF NOT EXIST build mkdir build
@@ -8,8 +8,12 @@ SDL_INCLUDE_DIR="/usr/local/include/SDL2"
 IMGUI_DIR="${PWD}/imgui"
 STB_DIR="${PWD}/stb"
 GLAD_DIR="${PWD}/glad"
+TOOLS_DIR="${PWD}/tools"
 GAME_C_SRCS=$(find "${GAME_DIR}" | grep -v "windows" | grep "\.c$")
 GAME_CPP_SRCS=$(find "${GAME_DIR}" | grep -v "windows" | grep "\.cpp$")
+# game sources with no SDL/GL dependency; tools link against just these
+HEADLESS_C_SRCS="${GAME_DIR}/engine.c ${GAME_DIR}/bitboard.c ${GAME_DIR}/boxsum.c ${GAME_DIR}/rng.c ${GAME_DIR}/solver.c ${GAME_DIR}/job.c ${GAME_DIR}/noguess.c ${GAME_DIR}/prob.c ${GAME_DIR}/replay.c ${GAME_DIR}/log.c ${GAME_DIR}/mem.c ${GAME_DIR}/linux.c"
+TOOLS="bench batch server"
 GAME_INCLUDE_DIRS="-I${GAME_DIR}/include -I${GLAD_DIR}/include -I${IMGUI_DIR} -I${IMGUI_DIR}/backends -I${STB_DIR} -I${SDL_INCLUDE_DIR}"
 
 LINKER_DEBUG_FLAGS="-pg"
@@ -18,19 +22,22 @@ DEBUG_FLAGS="-DDEBUG -DTEST -g -pg"
 OTHER_FLAGS="-DPLATFORM_GL_MAJOR_VERSION=3 -DPLATFORM_GL_MINOR_VERSION=3"
 COMPILER_FLAGS="-c -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -fPIC"
 
-LINKER_FLAGS="$(sdl2-config --libs --cflags) -ldl"
+LINKER_FLAGS="$(sdl2-config --libs --cflags) -ldl -pthread"
+TOOLS_LINKER_FLAGS="-pthread -lm"
 
 VERSION=1.0
 
 BUILD_GLAD=0
 BUILD_IMGUI=0
 BUILD_GAME=0
+BUILD_TOOLS=0
 NO_LINK=0
 DEBUG=0
 
 usage () {
-    echo "USAGE: $0 [--debug] [--nolink] [--all] [--glad] [--imgui] [--game] [OUT_DIR]"
-    echo "Builds (--all) by default, otherwise compile and link any of glad, imgui, game."
+    echo "USAGE: $0 [--debug] [--nolink] [--all] [--glad] [--imgui] [--game] [--tools] [OUT_DIR]"
+    echo "Builds (--all) by default, otherwise compile and link any of glad, imgui, game, tools."
+    echo "Tools (${TOOLS}) are headless and built into ${BUILD_DIR}/tools; they aren't packaged."
     echo "Produces built game files and tarball in OUT_DIR (\"\$PWD/out\" by default)."
     echo "Specify --nolink to disable the above - only compile .o files"
     echo "Specify --debug to build with debugger info, gprof info, and #defines DEBUG and TEST"
@@ -42,6 +49,7 @@ while [[ $# -gt 0 ]]; do
             BUILD_GLAD=1
             BUILD_IMGUI=1
             BUILD_GAME=1
+            BUILD_TOOLS=1
             shift
             ;;
         --debug)
@@ -64,6 +72,10 @@ while [[ $# -gt 0 ]]; do
             BUILD_GAME=1
             shift
             ;;
+        --tools)
+            BUILD_TOOLS=1
+            shift
+            ;;
         -*|--*)
             echo "Unknown option \"$1\""
             usage
@@ -87,16 +99,18 @@ then
 fi
 
 # if none specified, build all
-if [ "$BUILD_GLAD" -eq "0" ] && [ "$BUILD_IMGUI" -eq "0" ] && [ "$BUILD_GAME" -eq "0" ];
+if [ "$BUILD_GLAD" -eq "0" ] && [ "$BUILD_IMGUI" -eq "0" ] && [ "$BUILD_GAME" -eq "0" ] && [ "$BUILD_TOOLS" -eq "0" ];
 then
     BUILD_GLAD=1
     BUILD_IMGUI=1
     BUILD_GAME=1
+    BUILD_TOOLS=1
 fi
 
 if [ "$DEBUG" -eq "1" ]; then
     COMPILER_FLAGS="$COMPILER_FLAGS $DEBUG_FLAGS"
     LINKER_FLAGS="$LINKER_FLAGS $LINKER_DEBUG_FLAGS"
+    TOOLS_LINKER_FLAGS="$TOOLS_LINKER_FLAGS $LINKER_DEBUG_FLAGS"
 fi
 
 mkdir -p "${BUILD_DIR}"
@@ -131,7 +145,26 @@ then
     time g++ ${GAME_CPP_SRCS} ${COMPILER_FLAGS} ${GAME_INCLUDE_DIRS} ${OTHER_FLAGS} || exit 1
 fi
 
-if [ "$NO_LINK" -eq "0" ];
+if [ "$BUILD_TOOLS" -eq "1" ]
+then
+    # separate dir so the tools' main()s don't get linked into the game
+    mkdir -p tools
+    pushd tools > /dev/null
+    echo "compiling headless game .c files for tools:"
+    echo "${HEADLESS_C_SRCS}"
+    time gcc ${HEADLESS_C_SRCS} ${COMPILER_FLAGS} -O2 "-I${GAME_DIR}/include" || exit 1
+    for TOOL in ${TOOLS}; do
+        echo "compiling tool ${TOOL}"
+        time gcc "${TOOLS_DIR}/${TOOL}.c" ${COMPILER_FLAGS} -O2 "-I${GAME_DIR}/include" -o "${TOOL}.tool.o" || exit 1
+        if [ "$NO_LINK" -eq "0" ]; then
+            # .tool.o so the next tool's link doesn't pick this one up
+            gcc $(ls *.o | grep -v "\.tool\.o$") "${TOOL}.tool.o" ${TOOLS_LINKER_FLAGS} -o "${TOOL}" || exit 1
+        fi
+    done
+    popd > /dev/null
+fi
+
+if [ "$NO_LINK" -eq "0" ] && { [ "$BUILD_GLAD" -eq "1" ] || [ "$BUILD_IMGUI" -eq "1" ] || [ "$BUILD_GAME" -eq "1" ]; };
 then
     echo "linking .o files:"
     echo *.o
@@ -0,0 +1,231 @@
+#include<string.h> // memset
+
+#include"types.h"
+#include"bitboard.h"
+
+C_BEGIN
+
+u64 bitboard_mem_size(u32 width, u32 height)
+{
+    return bitboard_plane_words(width, height) * sizeof(u64) * BITPLANE_NUM_PLANES;
+}
+
+void bitboard_attach(BitBoard *bits, u32 width, u32 height, void *mem)
+{
+    ASSERT(bits);
+    ASSERT(mem);
+    ASSERT(ALIGN_UP_POW_2(mem, sizeof(u64)) == (u64)mem);
+
+    u64 plane_words = bitboard_plane_words(width, height);
+    u64 *words = (u64 *)mem;
+
+    bits->width = width;
+    bits->height = height;
+    bits->words_per_row = (width + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS;
+    for (u32 i = 0; i < BITPLANE_NUM_PLANES; ++i) {
+        bits->planes[i] = words;
+        words += plane_words;
+    }
+}
+
+void bitboard_init(BitBoard *bits, u32 width, u32 height, void *mem)
+{
+    bitboard_attach(bits, width, height, mem);
+    memset(mem, 0, bitboard_mem_size(width, height));
+}
+
+u64 bitboard_popcount(BitBoard *bits, u32 plane)
+{
+    ASSERT(bits);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+
+    u64 *words = bits->planes[plane];
+    u64 num_words = bitboard_plane_words(bits->width, bits->height);
+    u64 count = 0;
+    for (u64 i = 0; i < num_words; ++i) {
+        count += POPCOUNT_U64(words[i]);
+    }
+    return count;
+}
+
+u64 bitboard_popcount_and_not(BitBoard *bits, u32 plane, u32 mask_plane)
+{
+    ASSERT(bits);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+    ASSERT(mask_plane < BITPLANE_NUM_PLANES);
+
+    u64 *words = bits->planes[plane];
+    u64 *mask_words = bits->planes[mask_plane];
+    u64 num_words = bitboard_plane_words(bits->width, bits->height);
+    u64 count = 0;
+    for (u64 i = 0; i < num_words; ++i) {
+        count += POPCOUNT_U64(words[i] & ~mask_words[i]);
+    }
+    return count;
+}
+
+bool bitboard_padding_clear(BitBoard *bits)
+{
+    ASSERT(bits);
+
+    u32 used_bits = bits->width % BITBOARD_WORD_BITS;
+    if (used_bits == 0) {
+        return true;
+    }
+    u64 padding = ~0ULL << used_bits;
+    for (u32 i = 0; i < BITPLANE_NUM_PLANES; ++i) {
+        u64 *last_word = bits->planes[i] + bits->words_per_row - 1;
+        for (u32 r = 0; r < bits->height; ++r) {
+            if (last_word[(u64)r * bits->words_per_row] & padding) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 3 bits of a row centered on column c; a bit per column c-1, c, c+1 (where they exist)
+static u64 row_bits_around(BitBoard *bits, u64 *row, u32 c)
+{
+    u32 w = c / BITBOARD_WORD_BITS;
+    u32 i = c % BITBOARD_WORD_BITS;
+    u64 mask = (i == 0 ? 0x3ULL : 0x7ULL << (i - 1));
+    u64 ret = POPCOUNT_U64(row[w] & mask);
+    // neighbours that spill into adjacent words
+    if (i == 0 && w > 0) {
+        ret += row[w - 1] >> (BITBOARD_WORD_BITS - 1);
+    }
+    if (i == BITBOARD_WORD_BITS - 1 && w + 1 < bits->words_per_row) {
+        ret += row[w + 1] & 1;
+    }
+    return ret;
+}
+
+u32 bitboard_count_around(BitBoard *bits, u32 plane, u32 c, u32 r)
+{
+    ASSERT(bits);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+    ASSERT(c < bits->width);
+    ASSERT(r < bits->height);
+
+    u64 *words = bits->planes[plane];
+    u32 r_start = r > 0 ? r - 1 : 0;
+    u32 r_end = MIN(r + 1, bits->height - 1);
+    u64 count = 0;
+    for (u32 rr = r_start; rr <= r_end; ++rr) {
+        count += row_bits_around(bits, &words[(u64)rr * bits->words_per_row], c);
+    }
+    return (u32)count;
+}
+
+void bitboard_for_each_and_not(BitBoard *bits, u32 plane, u32 mask_plane,
+                               void (*fn)(void *data, u32 c, u32 r), void *data)
+{
+    ASSERT(bits);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+    ASSERT(mask_plane < BITPLANE_NUM_PLANES);
+    ASSERT(fn);
+
+    u64 *words = bits->planes[plane];
+    u64 *mask_words = bits->planes[mask_plane];
+    for (u32 r = 0; r < bits->height; ++r) {
+        u64 row_off = (u64)r * bits->words_per_row;
+        for (u32 w = 0; w < bits->words_per_row; ++w) {
+            u64 word = words[row_off + w] & ~mask_words[row_off + w];
+            while (word) {
+                u32 i = CTZ_U64(word);
+                fn(data, w * BITBOARD_WORD_BITS + i, r);
+                word &= word - 1; // clear lowest set bit
+            }
+        }
+    }
+}
+
+/*
+ * Word w of row r with the neighbouring columns shifted in
+ * left[i]  == bit of column i - 1
+ * right[i] == bit of column i + 1
+ */
+static void row_neighbours(BitBoard *bits, u64 *plane, i64 r, u32 w,
+                           u64 *left, u64 *mid, u64 *right)
+{
+    if (r < 0 || r >= bits->height) {
+        *left = *mid = *right = 0;
+        return;
+    }
+    u64 *row = &plane[(u64)r * bits->words_per_row];
+    u64 prev = w > 0 ? row[w - 1] : 0;
+    u64 next = w + 1 < bits->words_per_row ? row[w + 1] : 0;
+    *mid = row[w];
+    *left = (*mid << 1) | (prev >> (BITBOARD_WORD_BITS - 1));
+    *right = (*mid >> 1) | (next << (BITBOARD_WORD_BITS - 1));
+}
+
+void bitboard_count_neighbours_row(BitBoard *bits, u32 r, u8 *counts)
+{
+    ASSERT(bits);
+    ASSERT(r < bits->height);
+    ASSERT(counts);
+
+    u64 *bombs = bits->planes[BITPLANE_BOMB];
+
+    for (u32 w = 0; w < bits->words_per_row; ++w) {
+        u64 al, am, ar; // above
+        u64 cl, cm, cr; // current row; cm is the cell itself so not counted
+        u64 bl, bm, br; // below
+        row_neighbours(bits, bombs, (i64)r - 1, w, &al, &am, &ar);
+        row_neighbours(bits, bombs, r, w, &cl, &cm, &cr);
+        row_neighbours(bits, bombs, (i64)r + 1, w, &bl, &bm, &br);
+
+        /* each bit position is an independent little adder */
+        // above: full adder, 0..3
+        u64 a0 = al ^ am ^ ar;
+        u64 a1 = (al & am) | (ar & (al ^ am));
+        // below: full adder, 0..3
+        u64 b0 = bl ^ bm ^ br;
+        u64 b1 = (bl & bm) | (br & (bl ^ bm));
+        // current: half adder, 0..2
+        u64 c0 = cl ^ cr;
+        u64 c1 = cl & cr;
+
+        // t = a + b, 0..6
+        u64 k = a0 & b0;
+        u64 t0 = a0 ^ b0;
+        u64 t1 = a1 ^ b1 ^ k;
+        u64 t2 = (a1 & b1) | (k & (a1 ^ b1));
+        // s = t + c, 0..8
+        k = t0 & c0;
+        u64 s0 = t0 ^ c0;
+        u64 s1 = t1 ^ c1 ^ k;
+        k = (t1 & c1) | (k & (t1 ^ c1));
+        u64 s2 = t2 ^ k;
+        u64 s3 = t2 & k;
+
+        // bombs get 0
+        s0 &= ~cm;
+        s1 &= ~cm;
+        s2 &= ~cm;
+        s3 &= ~cm;
+
+        u32 c_start = w * BITBOARD_WORD_BITS;
+        u32 c_end = MIN(c_start + BITBOARD_WORD_BITS, bits->width);
+        for (u32 c = c_start, i = 0; c < c_end; ++c, ++i) {
+            counts[c] = (u8)(((s0 >> i) & 1) |
+                             (((s1 >> i) & 1) << 1) |
+                             (((s2 >> i) & 1) << 2) |
+                             (((s3 >> i) & 1) << 3));
+        }
+    }
+}
+
+void bitboard_count_neighbours(BitBoard *bits, u8 *counts)
+{
+    ASSERT(bits);
+    ASSERT(counts);
+
+    for (u32 r = 0; r < bits->height; ++r) {
+        bitboard_count_neighbours_row(bits, r, &counts[(u64)r * bits->width]);
+    }
+}
+
+C_END
@@ -0,0 +1,170 @@
+#include"types.h"
+#include"atomic.h"
+#include"boxsum.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BOXSUM_X86 1
+#include<immintrin.h>
+#ifdef _WIN32
+#include<intrin.h>
+#endif
+#endif
+
+// msvc doesn't need (or have) target attributes to use avx2 intrinsics
+#ifdef __GNUC__
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+C_BEGIN
+
+/*
+ * Count for cells [c, width) of one row
+ * up, mid, down point at column c - 1 of the padded rows above, at and below
+ */
+static void boxsum_row_scalar(const u8 *up, const u8 *mid, const u8 *down,
+                              u8 *out, u32 c, u32 width)
+{
+    for (; c < width; ++c) {
+        u32 sum = up[c] + up[c + 1] + up[c + 2] +
+                  mid[c] +            mid[c + 2] +
+                  down[c] + down[c + 1] + down[c + 2];
+        out[c] = mid[c + 1] ? 0 : (u8)sum;
+    }
+}
+
+#ifdef BOXSUM_X86
+
+static void boxsum_row_sse2(const u8 *up, const u8 *mid, const u8 *down,
+                            u8 *out, u32 width)
+{
+    u32 c = 0;
+    __m128i zero = _mm_setzero_si128();
+    for (; c + 16 <= width; c += 16) {
+        // vertical sums of the 3 columns, then add them horizontally
+        __m128i left = _mm_add_epi8(_mm_add_epi8(_mm_loadu_si128((const __m128i *)&up[c]),
+                                                 _mm_loadu_si128((const __m128i *)&mid[c])),
+                                    _mm_loadu_si128((const __m128i *)&down[c]));
+        __m128i self = _mm_loadu_si128((const __m128i *)&mid[c + 1]);
+        __m128i centre = _mm_add_epi8(_mm_loadu_si128((const __m128i *)&up[c + 1]),
+                                      _mm_loadu_si128((const __m128i *)&down[c + 1]));
+        __m128i right = _mm_add_epi8(_mm_add_epi8(_mm_loadu_si128((const __m128i *)&up[c + 2]),
+                                                  _mm_loadu_si128((const __m128i *)&mid[c + 2])),
+                                     _mm_loadu_si128((const __m128i *)&down[c + 2]));
+        __m128i sum = _mm_add_epi8(_mm_add_epi8(left, centre), right);
+        // zero where the cell itself is a bomb
+        __m128i not_bomb = _mm_cmpeq_epi8(self, zero);
+        _mm_storeu_si128((__m128i *)&out[c], _mm_and_si128(sum, not_bomb));
+    }
+    boxsum_row_scalar(up, mid, down, out, c, width);
+}
+
+TARGET_AVX2
+static void boxsum_row_avx2(const u8 *up, const u8 *mid, const u8 *down,
+                            u8 *out, u32 width)
+{
+    u32 c = 0;
+    __m256i zero = _mm256_setzero_si256();
+    for (; c + 32 <= width; c += 32) {
+        __m256i left = _mm256_add_epi8(_mm256_add_epi8(_mm256_loadu_si256((const __m256i *)&up[c]),
+                                                       _mm256_loadu_si256((const __m256i *)&mid[c])),
+                                       _mm256_loadu_si256((const __m256i *)&down[c]));
+        __m256i self = _mm256_loadu_si256((const __m256i *)&mid[c + 1]);
+        __m256i centre = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)&up[c + 1]),
+                                         _mm256_loadu_si256((const __m256i *)&down[c + 1]));
+        __m256i right = _mm256_add_epi8(_mm256_add_epi8(_mm256_loadu_si256((const __m256i *)&up[c + 2]),
+                                                        _mm256_loadu_si256((const __m256i *)&mid[c + 2])),
+                                        _mm256_loadu_si256((const __m256i *)&down[c + 2]));
+        __m256i sum = _mm256_add_epi8(_mm256_add_epi8(left, centre), right);
+        __m256i not_bomb = _mm256_cmpeq_epi8(self, zero);
+        _mm256_storeu_si256((__m256i *)&out[c], _mm256_and_si256(sum, not_bomb));
+    }
+    boxsum_row_scalar(up, mid, down, out, c, width);
+}
+
+static bool cpu_has_avx2()
+{
+#ifdef __GNUC__
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return false;
+    }
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    // os saves the ymm registers
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] >> 5) & 1;
+#endif
+}
+
+#endif // BOXSUM_X86
+
+u32 boxsum_best_kernel()
+{
+#ifdef BOXSUM_X86
+    /*
+     * Called from every worker thread; any that race here all pick the
+     * same kernel, so there's nothing to do but make the access atomic
+     */
+    static volatile u32 best = BOXSUM_NUM_KERNELS;
+    u32 kernel = atomic_load_u32(&best);
+    if (kernel == BOXSUM_NUM_KERNELS) {
+        // sse2 is part of x86-64
+        kernel = cpu_has_avx2() ? BOXSUM_AVX2 : BOXSUM_SSE2;
+        atomic_store_u32(&best, kernel);
+    }
+    return kernel;
+#else
+    return BOXSUM_SCALAR;
+#endif
+}
+
+const char *boxsum_kernel_name(u32 kernel)
+{
+    static const char *names[BOXSUM_NUM_KERNELS] = { "scalar", "sse2", "avx2" };
+    ASSERT(kernel < BOXSUM_NUM_KERNELS);
+    return names[kernel];
+}
+
+void boxsum_count(u32 kernel, const u8 *mask, u32 width, u32 height, u8 *counts)
+{
+    ASSERT(mask);
+    ASSERT(counts);
+    ASSERT(kernel <= boxsum_best_kernel());
+
+    u64 stride = (u64)width + 2;
+    for (u32 r = 0; r < height; ++r) {
+        // padded rows r, r + 1, r + 2 are board rows r - 1, r, r + 1
+        const u8 *up = &mask[(u64)r * stride];
+        const u8 *mid = up + stride;
+        const u8 *down = mid + stride;
+        u8 *out = &counts[(u64)r * width];
+        switch (kernel) {
+#ifdef BOXSUM_X86
+            case BOXSUM_AVX2:
+                boxsum_row_avx2(up, mid, down, out, width);
+                break;
+            case BOXSUM_SSE2:
+                boxsum_row_sse2(up, mid, down, out, width);
+                break;
+#endif
+            default:
+                boxsum_row_scalar(up, mid, down, out, 0, width);
+                break;
+        }
+    }
+}
+
+C_END
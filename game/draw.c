@@ -1,3 +1,4 @@
+#include<math.h>
 #include"glad/glad.h"
 #include"types.h"
 #include"log.h"
@@ -354,16 +355,18 @@ static void geom_deinit(Geom *geom)
     dump_errors();
 }
 
+// two triangles of a sprite's quad
+static const GLuint spr_indices[] = {
+    0,1,2,
+    3,2,1
+};
+
 void get_sprite_verts_indices(Vec2f pos, Vec2f dims, Sprite *spr, Vertex *verts, GLuint *indices, GLuint index_offset)
 {
     ASSERT(spr);
     ASSERT(verts);
     ASSERT(indices);
 
-    static const GLuint spr_indices[] = {
-        0,1,2,
-        3,2,1
-    };
     for (u32 i = 0; i < ARRAY_LEN(spr_indices); ++i) {
         indices[i] = spr_indices[i] + index_offset;
     }
@@ -417,16 +420,13 @@ static void draw_sprite(Sprite *sprite, Vec2f pos, Vec2f dims)
     geom_deinit(&geom);
 }
 
-static Vec2f cell_pixel_pos(Board *board, Cell *cell)
+// in play area pixels; the camera transform puts them on screen
+static Vec2f cell_pixel_pos(i64 col, i64 row)
 {
-
-    i64 col, row;
     Vec2f pos;
-    Vec2f offset = cells_offset_px();
 
-    board_cell_to_pos(board, cell, &col, &row);
-    pos.x = offset.x + (f32)col * CELL_PIXEL_WIDTH;
-    pos.y = offset.y + (f32)row * CELL_PIXEL_WIDTH;
+    pos.x = (f32)col * CELL_PIXEL_WIDTH;
+    pos.y = (f32)row * CELL_PIXEL_WIDTH;
 
     return pos;
 }
@@ -515,47 +515,240 @@ static void draw_sprite_array(Array *sprites, Array *positions)
     geom_deinit(&geom);
 }
 
-static void draw_cells(Board *board)
+typedef struct {
+    u32 col;
+    u32 row;
+    u32 cols;
+    u32 rows;
+} CellRect;
+
+/*
+ * Cell quads stay on the GPU between frames: every cell's back, then
+ * every cell's front (collapsed to a point if it has none), so the red
+ * bomb background can go between the two
+ * Only the cells in rect are in it, the ones in view and a margin around
+ * them; it's built again when the camera moves out of that
+ * Each frame only the cells in board->changes are rewritten
+ */
+typedef struct {
+    Geom geom;
+    u64 num_cells;
+    CellRect rect;
+    bool loaded;
+} CellMesh;
+
+static CellMesh cell_mesh;
+
+// past this many changed cells it's quicker to upload the whole mesh again
+#define CELL_MESH_MAX_UPDATES 1024
+// cells either side of the view, so panning doesn't rebuild every frame
+#define CELL_MESH_MARGIN 16
+
+// the play area cells any part of which the camera can see
+static CellRect visible_cells()
 {
-    Array sprites;
-    Array positions;
+    Camera *camera = &game_state.camera;
+    Vec2f view_dims = view_dims_px();
+    i64 cols = play_area_cols();
+    i64 rows = play_area_rows();
+    f32 left = camera->pos.x / CELL_PIXEL_WIDTH;
+    f32 top = camera->pos.y / CELL_PIXEL_HEIGHT;
+    f32 right = (camera->pos.x + view_dims.x / camera->zoom) / CELL_PIXEL_WIDTH;
+    f32 bottom = (camera->pos.y + view_dims.y / camera->zoom) / CELL_PIXEL_HEIGHT;
+
+    i64 col = CLAMP((i64)floorf(left), 0, cols);
+    i64 row = CLAMP((i64)floorf(top), 0, rows);
+    i64 col_end = CLAMP((i64)ceilf(right), col, cols);
+    i64 row_end = CLAMP((i64)ceilf(bottom), row, rows);
+
+    CellRect rect = {(u32)col, (u32)row, (u32)(col_end - col), (u32)(row_end - row)};
+    return rect;
+}
 
-    CHECKV(try_alloc_array(sprites, board->num_cells, Sprite*));
-    CHECKV(try_alloc_array(positions, board->num_cells, Vec2f));
+static bool cell_rect_contains(CellRect outer, CellRect inner)
+{
+    return inner.col >= outer.col && inner.col + inner.cols <= outer.col + outer.cols &&
+           inner.row >= outer.row && inner.row + inner.rows <= outer.row + outer.rows;
+}
+
+static CellRect cell_rect_grow(CellRect rect, u32 margin)
+{
+    u32 col = rect.col - MIN(rect.col, margin);
+    u32 row = rect.row - MIN(rect.row, margin);
+    u32 col_end = (u32)MIN((u64)rect.col + rect.cols + margin, (u64)play_area_cols());
+    u32 row_end = (u32)MIN((u64)rect.row + rect.rows + margin, (u64)play_area_rows());
+
+    CellRect grown = {col, row, col_end - col, row_end - row};
+    return grown;
+}
+
+// quads for the play area cell at col, row; collapsed to a point in the gaps between boards
+static void cell_mesh_verts(i64 col, i64 row, Vertex *back, Vertex *front)
+{
+    Vec2f pos = cell_pixel_pos(col, row);
+    GLuint indices[6];
+    u32 board_idx, c, r;
 
-    for (u32 i = 0; i < board->num_cells; ++i) {
-        Cell *cell = &board->cells[i];
-        Vec2f pos = cell_pixel_pos(board, cell);
-        Sprite *spr = spr_cell_back(board, cell);
-        array_append(&sprites, &spr, 1);
-        array_append(&positions, &pos, 1);
+    if (!play_area_to_board(col, row, &board_idx, &c, &r)) {
+        Sprite *spr = SPRITEI(CELL, SPR_CELL_UP);
+        get_sprite_verts_indices(pos, vec2f(0, 0), spr, back, indices, 0);
+        get_sprite_verts_indices(pos, vec2f(0, 0), spr, front, indices, 0);
+        return;
+    }
+    Board *board = &game_engine(board_idx)->board;
+    Cell *cell = board_pos_to_cell(board, c, r);
+
+    Sprite *spr = spr_cell_back(board, cell);
+    get_sprite_verts_indices(pos, spr->size_px, spr, back, indices, 0);
+    spr = spr_cell_front(board, cell);
+    if (spr) {
+        get_sprite_verts_indices(pos, spr->size_px, spr, front, indices, 0);
+    } else {
+        spr = SPRITEI(CELL, SPR_CELL_UP);
+        get_sprite_verts_indices(pos, vec2f(0, 0), spr, front, indices, 0);
     }
+}
 
-    draw_sprite_array(&sprites, &positions);
+static bool cell_mesh_build(CellRect rect)
+{
+    u64 num_cells = (u64)rect.cols * rect.rows;
+    Vertex *verts = mem_alloc(num_cells * 2 * 4 * sizeof(Vertex));
+    GLuint *indices = mem_alloc(num_cells * 2 * 6 * sizeof(GLuint));
+    CHECK_LOG(verts && indices, false, "Failed to alloc cell mesh");
+
+    u64 idx = 0;
+    for (u32 r = rect.row; r < rect.row + rect.rows; ++r) {
+        for (u32 c = rect.col; c < rect.col + rect.cols; ++c) {
+            u64 front_idx = num_cells + idx;
+            cell_mesh_verts(c, r, &verts[idx * 4], &verts[front_idx * 4]);
+            for (u32 i = 0; i < ARRAY_LEN(spr_indices); ++i) {
+                indices[idx * 6 + i] = spr_indices[i] + (GLuint)(idx * 4);
+                indices[front_idx * 6 + i] = spr_indices[i] + (GLuint)(front_idx * 4);
+            }
+            idx++;
+        }
+    }
 
-    array_clear(&sprites);
-    array_clear(&positions);
+    cell_mesh.num_cells = num_cells;
+    cell_mesh.rect = rect;
+    cell_mesh.geom.num_tris = (u32)(num_cells * 4);
+    glBindVertexArray(cell_mesh.geom.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, cell_mesh.geom.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(num_cells * 2 * 4 * sizeof(Vertex)), verts, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cell_mesh.geom.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(num_cells * 2 * 6 * sizeof(GLuint)), indices, GL_STATIC_DRAW);
+    dump_errors();
 
-    // red bomb background
-    if (board->bomb_clicked != NULL) {
-        Sprite *spr = SPRITEI(CELL, 0);
-        shader_set_color(shader_flat, color_red());
-        draw_sprite(spr, cell_pixel_pos(board, board->bomb_clicked), spr->size_px);
-        shader_set_color(shader_flat, color_none());
+    return true;
+}
+
+// one mesh for every board, rewritten from all their change lists
+static void cell_mesh_update()
+{
+    CellRect visible = visible_cells();
+    bool rebuild = !cell_mesh.loaded || !cell_rect_contains(cell_mesh.rect, visible);
+    u64 num_changes = 0;
+    for (u32 i = 0; i < game_num_boards() && !rebuild; ++i) {
+        ChangeList *changes = &game_engine(i)->board.changes;
+        num_changes += changes->num;
+        rebuild = changes->all || num_changes > CELL_MESH_MAX_UPDATES;
+    }
+    if (rebuild) {
+        cell_mesh.loaded = cell_mesh_build(cell_rect_grow(visible, CELL_MESH_MARGIN));
+        return;
     }
 
-    for (u32 i = 0; i < board->num_cells; ++i) {
-        Cell *cell = &board->cells[i];
-        Sprite *spr = spr_cell_front(board, cell);
-        if (!spr) {
-            continue;
+    CellRect rect = cell_mesh.rect;
+    glBindBuffer(GL_ARRAY_BUFFER, cell_mesh.geom.vbo);
+    for (u32 b = 0; b < game_num_boards(); ++b) {
+        Board *board = &game_engine(b)->board;
+        ChangeList *changes = &board->changes;
+        i64 board_col, board_row;
+        play_area_board_pos(b, &board_col, &board_row);
+        for (u32 i = 0; i < changes->num; ++i) {
+            i64 c, r;
+            board_idx_to_pos(board, changes->idxs[i], &c, &r);
+            c += board_col;
+            r += board_row;
+            // out of view; it'll be right when the camera gets there and the mesh is rebuilt
+            if (c < rect.col || c >= rect.col + rect.cols || r < rect.row || r >= rect.row + rect.rows) {
+                continue;
+            }
+            u64 idx = (u64)(r - rect.row) * rect.cols + (u64)(c - rect.col);
+            Vertex back[4];
+            Vertex front[4];
+            cell_mesh_verts(c, r, back, front);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(idx * sizeof(back)), sizeof(back), back);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)((cell_mesh.num_cells + idx) * sizeof(front)),
+                            sizeof(front), front);
         }
-        Vec2f pos = cell_pixel_pos(board, cell);
-        array_append(&sprites, &spr, 1);
-        array_append(&positions, &pos, 1);
     }
+    dump_errors();
+}
 
-    draw_sprite_array(&sprites, &positions);
+/*
+ * Every board's cells in two draw calls, backs then fronts, with the red
+ * backgrounds of any bombs clicked in one more between them
+ */
+static void draw_cells()
+{
+    // no board to draw yet
+    if (!cell_mesh.geom.vao) {
+        return;
+    }
+    cell_mesh_update();
+    if (!cell_mesh.loaded) {
+        return;
+    }
+    u64 num_indices = cell_mesh.num_cells * 6;
+
+    // play area pixels -> game pixels, and nothing outside the view
+    Camera *camera = &game_state.camera;
+    Vec2f offset = cells_offset_px();
+    Vec2f view_dims = view_dims_px();
+    Mat4 translate = mat4_translate(offset.x - camera->pos.x * camera->zoom,
+                                    offset.y - camera->pos.y * camera->zoom, 0);
+    Mat4 scale = mat4_scale(camera->zoom, camera->zoom, 1);
+    Mat4 view = mat4_mul(&translate, &scale);
+    shader_set_view(shader_flat, &view);
+    render_clip_pixels(offset.x, offset.y, view_dims.x, view_dims.y);
+
+    glBindVertexArray(cell_mesh.geom.vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)num_indices, GL_UNSIGNED_INT, 0);
+
+    // red bomb backgrounds
+    Array sprites;
+    Array positions;
+    if (try_alloc_array(sprites, game_num_boards(), Sprite*) &&
+        try_alloc_array(positions, game_num_boards(), Vec2f)) {
+        Sprite *spr = SPRITEI(CELL, 0);
+        for (u32 b = 0; b < game_num_boards(); ++b) {
+            Board *board = &game_engine(b)->board;
+            if (board->bomb_clicked == BOARD_NO_CELL) {
+                continue;
+            }
+            i64 board_col, board_row, c, r;
+            play_area_board_pos(b, &board_col, &board_row);
+            board_idx_to_pos(board, board->bomb_clicked, &c, &r);
+            Vec2f pos = cell_pixel_pos(board_col + c, board_row + r);
+            array_append(&sprites, &spr, 1);
+            array_append(&positions, &pos, 1);
+        }
+        if (sprites.len > 0) {
+            shader_set_color(shader_flat, color_red());
+            draw_sprite_array(&sprites, &positions);
+            shader_set_color(shader_flat, color_none());
+        }
+    }
+
+    glBindVertexArray(cell_mesh.geom.vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)num_indices, GL_UNSIGNED_INT,
+                   (void *)(num_indices * sizeof(GLuint)));
+
+    // the rest is drawn in game pixels
+    Mat4 ident = mat4_ident();
+    shader_set_view(shader_flat, &ident);
+    render_clip_none();
 }
 
 static void draw_face()
@@ -579,7 +772,7 @@ static void draw_face()
     draw_sprite(spr_front, pos_front, spr_front->size_px);
 }
 
-static void draw_borders(Board *board)
+static void draw_borders()
 {
     // this is gonna be pretty manual...
     Vec2f game_dims = game_dims_px();
@@ -625,7 +818,7 @@ static void draw_borders(Board *board)
     // vert
     Sprite *spr_vert = SPRITE(BORDER, 0, 0);
     u32 num_borders_y_top = TOP_INTERIOR_HEIGHT / BORDER_PIXEL_HEIGHT;
-    u32 num_borders_y_cells = (board->height * CELL_PIXEL_HEIGHT) / BORDER_PIXEL_HEIGHT;
+    u32 num_borders_y_cells = (view_rows() * CELL_PIXEL_HEIGHT) / BORDER_PIXEL_HEIGHT;
 
     // the sprites are all the same so just fill with what we need
     array_fill(&sprites, &spr_vert, (num_borders_y_top + num_borders_y_cells) * 2);
@@ -689,22 +882,16 @@ void draw_counter(u32 n, Vec2f pos)
 
 void draw_counters()
 {
-    Board *board = &game_state.board;
+    i64 n = 0;
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        n += game_engine(i)->board.bombs_left;
+    }
     // stop at 0, no negative numbers
-    i64 n = MAX(board->bombs_left, 0);
-    ASSERT(n <= COUNTER_MAX);
+    n = MAX(n, 0);
+    n = MIN(n, COUNTER_MAX);
     draw_counter((u32)n, counter_bombs_pos_px());
 
-    u64 t = game_state.time_ms;
-    if (t == UINT64_MAX) {
-        t = 0;
-    } else {
-        ASSERT(t >= game_state.time_started_ms);
-        t -= game_state.time_started_ms;
-        t /= 1000;
-        t = MIN(t, COUNTER_MAX);
-    }
-    draw_counter((u32)t, counter_timer_pos_px());
+    draw_counter(game_timer_shown(), counter_timer_pos_px());
 }
 
 void draw_game()
@@ -728,9 +915,9 @@ void draw_game()
 
     shader_set_texture_array(shader_flat, tex_array);
 
-    draw_cells(&game_state.board);
+    draw_cells();
     draw_face();
-    draw_borders(&game_state.board);
+    draw_borders();
     draw_counters();
 
     render_end();
@@ -742,16 +929,21 @@ void draw_resize()
     shader_set_transform_pixels(shader_flat, dims.x, dims.y);
 }
 
-bool draw_start_game(Board* board)
+bool draw_start_game()
 {
-    ASSERT(board);
+    // the cells are uploaded on the first frame, when board->changes has them all
+    geom_init(&cell_mesh.geom);
+    cell_mesh.loaded = false;
 
     return true;
 }
 
-void draw_end_game(Board *board)
+void draw_end_game()
 {
-    ASSERT(board);
+    if (cell_mesh.geom.vao) {
+        geom_deinit(&cell_mesh.geom);
+    }
+    memset(&cell_mesh, 0, sizeof(cell_mesh));
 }
 
 bool draw_init()
@@ -0,0 +1,1039 @@
+#include<string.h> // memset
+
+#include"types.h"
+#include"log.h"
+#include"allocator.h"
+#include"boxsum.h"
+#include"engine.h"
+
+C_BEGIN
+
+// every allocation from the engine arena is rounded up to this
+#define ENGINE_ALIGN 16
+
+static void *engine_alloc(Engine *engine, u64 size)
+{
+    return bump_alloc(&engine->arena, ALIGN_UP_POW_2(size, ENGINE_ALIGN));
+}
+
+static void undo_record(UndoLog *log, u64 idx, u8 old_state, u8 new_state);
+
+// cells in a board's grid, including the border
+static u64 board_grid_cells(u32 width, u32 height)
+{
+    return ((u64)width + 2) * ((u64)height + 2);
+}
+
+/*
+ * Point the board at its grid (board_grid_cells() cells), whose first
+ * cell is the top left corner of the border
+ */
+static void board_set_grid(Board *board, Cell *grid)
+{
+    i64 stride = (i64)board->width + 2;
+    board->stride = (u32)stride;
+    board->cells = grid + stride + 1;
+    i64 *n = board->neighbours;
+    n[0] = -stride - 1; n[1] = -stride; n[2] = -stride + 1;
+    n[3] = -1;                          n[4] = 1;
+    n[5] = stride - 1;  n[6] = stride;  n[7] = stride + 1;
+}
+
+static bool cell_is_border(Cell *cell)
+{
+    return cell->is_border && cell->state == CELL_EXPLORED && !cell->is_bomb && cell->bombs_around == 0;
+}
+
+/*
+ * All cell state changes go through here, so the bitplanes (if any),
+ * num_safe_explored and bombs_left always match the cells, and moves
+ * being recorded for undo see every change
+ */
+static void board_set_state(Board *board, Cell *cell, u8 state)
+{
+    if (!cell->is_bomb) {
+        board->num_safe_explored += (state == CELL_EXPLORED) - (cell->state == CELL_EXPLORED);
+    }
+    board->bombs_left += (cell->state == CELL_FLAGGED) - (state == CELL_FLAGGED);
+    // presses come and go within a frame, so they aren't moves
+    if (board->undo && cell->state != CELL_CLICKED && state != CELL_CLICKED) {
+        undo_record(board->undo, board_cell_to_idx(board, cell), cell->state, state);
+    }
+    if (cell->state != state && !board->changes.all) {
+        ChangeList *changes = &board->changes;
+        if (changes->num < changes->capacity) {
+            changes->idxs[changes->num++] = board_cell_to_idx(board, cell);
+        } else {
+            changes->all = true;
+        }
+    }
+    cell->state = state;
+    if (board->use_bits) {
+        i64 c, r;
+        board_cell_to_pos(board, cell, &c, &r);
+        bitboard_set(&board->bits, BITPLANE_EXPLORED, (u32)c, (u32)r, state == CELL_EXPLORED);
+        bitboard_set(&board->bits, BITPLANE_FLAGGED, (u32)c, (u32)r, state == CELL_FLAGGED);
+    }
+}
+
+/*
+ * Drop the oldest half of the finished moves to make room
+ * Only called while recording, so there's nothing to redo
+ */
+static bool undo_drop_oldest(UndoLog *log)
+{
+    ASSERT(log->end_moves == log->num_moves);
+    if (log->num_moves == 0) {
+        return false;
+    }
+    u32 drop = MAX(log->num_moves / 2, 1);
+    // the move being recorded has an entry too
+    u32 num_entries = log->num_moves + log->recording;
+    u32 shift = drop < num_entries ? log->moves[drop].first_delta : log->num_deltas;
+    memmove(log->deltas, &log->deltas[shift], (u64)(log->num_deltas - shift) * sizeof(u32));
+    for (u32 m = drop; m < num_entries; ++m) {
+        log->moves[m - drop] = log->moves[m];
+        log->moves[m - drop].first_delta -= shift;
+    }
+    log->num_moves -= drop;
+    log->num_deltas -= shift;
+    log->end_moves = log->num_moves;
+    log->end_deltas = log->num_deltas;
+    return true;
+}
+
+static void undo_record(UndoLog *log, u64 idx, u8 old_state, u8 new_state)
+{
+    ASSERT(log->recording);
+    if (log->overflowed) {
+        return;
+    }
+    if (log->num_deltas == log->max_deltas && !undo_drop_oldest(log)) {
+        log->overflowed = true;
+        return;
+    }
+    log->deltas[log->num_deltas++] = UNDO_DELTA(idx, old_state, new_state);
+    log->end_deltas = log->num_deltas;
+}
+
+static void undo_begin_move(Engine *engine)
+{
+    UndoLog *log = &engine->undo;
+    if (!log->deltas) {
+        return;
+    }
+    // a new move replaces anything undone
+    log->end_moves = log->num_moves;
+    log->end_deltas = log->num_deltas;
+    if (log->num_moves == log->max_moves) {
+        undo_drop_oldest(log);
+    }
+    log->moves[log->num_moves].first_delta = log->num_deltas;
+    log->recording = true;
+    log->overflowed = false;
+    engine->board.undo = log;
+}
+
+static void undo_end_move(Engine *engine)
+{
+    UndoLog *log = &engine->undo;
+    if (!log->recording) {
+        return;
+    }
+    log->recording = false;
+    engine->board.undo = NULL;
+    if (log->overflowed) {
+        // only part of the move is in the log, so none of it can be undone
+        log_info("Move too big for the undo log, clearing it");
+        engine_undo_clear(engine);
+        return;
+    }
+    if (log->num_deltas == log->moves[log->num_moves].first_delta) {
+        // nothing changed
+        return;
+    }
+    log->moves[log->num_moves].status = engine->status;
+    log->num_moves++;
+    log->end_moves = log->num_moves;
+}
+
+u32 board_count_around(Board *board, u32 plane, u32 c, u32 r)
+{
+    ASSERT(board);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+
+    if (board->use_bits) {
+        return bitboard_count_around(&board->bits, plane, c, r);
+    }
+
+    // the border is never a bomb or flagged, and explored doesn't count there
+    Cell *centre = board_pos_to_cell(board, c, r);
+    u32 count = 0;
+    for (u32 i = 0; i <= ARRAY_LEN(board->neighbours); ++i) {
+        // the centre last
+        Cell *cell = i < ARRAY_LEN(board->neighbours) ? centre + board->neighbours[i] : centre;
+        switch (plane) {
+            case BITPLANE_BOMB:
+                count += cell->is_bomb;
+                break;
+            case BITPLANE_EXPLORED:
+                count += cell->state == CELL_EXPLORED && !cell->is_border;
+                break;
+            case BITPLANE_FLAGGED:
+                count += cell->state == CELL_FLAGGED;
+                break;
+        }
+    }
+    return count;
+}
+
+static void check_if_won(Engine *engine)
+{
+    Board *board = &engine->board;
+#ifdef DEBUG
+    if (board->use_bits) {
+        u64 num_explored = bitboard_popcount(&board->bits, BITPLANE_EXPLORED);
+        ASSERT(num_explored == board->num_safe_explored);
+    }
+#endif
+    if (board->num_safe_explored == board->num_cells - board->num_bombs) {
+        engine->status = ENGINE_WON;
+    }
+}
+
+/* Reveal cells c0..c1 of row r and tell the span listener about them */
+static void reveal_span(Engine *engine, u32 r, u32 c0, u32 c1)
+{
+    Board *board = &engine->board;
+    ASSERT(c0 <= c1);
+    ASSERT(c1 < board->width);
+
+    Cell *row = board_pos_to_cell(board, 0, r);
+    for (u32 c = c0; c <= c1; ++c) {
+        board_set_state(board, &row[c], CELL_EXPLORED);
+    }
+    if (engine->span_fn) {
+        engine->span_fn(engine->span_data, r, c0, c1);
+    }
+}
+
+static void reveal_bomb(void *data, u32 c, u32 r)
+{
+    Engine *engine = (Engine *)data;
+    // skip the bomb that was clicked
+    if (board_pos_to_cell(&engine->board, c, r)->state != CELL_EXPLORED) {
+        reveal_span(engine, r, c, c);
+    }
+}
+
+static bool is_unexplored_empty(Cell *cell)
+{
+    return cell->state == CELL_UNEXPLORED && cell->bombs_around == 0;
+}
+
+/*
+ * Reveal the cells of row r in [c0, c1] that are still unexplored,
+ * neighbours of the span being filled
+ * Numbers are revealed straight away. Each run of empty cells gets its
+ * first cell revealed and pushed as a seed; the rest of the run is left
+ * for the seed's own span to pick up
+ * The row and span can take in the border, which is never unexplored
+ */
+static void fill_scan_row(Engine *engine, i64 r, i64 c0, i64 c1, u32 *stack, u32 *stack_len)
+{
+    Board *board = &engine->board;
+    Cell *row = board->cells + r * (i64)board->stride;
+    bool in_empty_run = false;
+    // start of the current run of revealed cells, to report as one span
+    i64 reveal_start = -1;
+
+    for (i64 c = c0; c <= c1; ++c) {
+        Cell *cell = &row[c];
+        bool reveal = false;
+        if (cell->state != CELL_UNEXPLORED) {
+            in_empty_run = false;
+        } else if (cell->bombs_around > 0) {
+            ASSERT(!cell->is_bomb);
+            in_empty_run = false;
+            reveal = true;
+        } else if (!in_empty_run) {
+            in_empty_run = true;
+            reveal = true;
+            // seeds are revealed when pushed, so no cell is ever pushed twice
+            ASSERT(*stack_len < board->num_cells);
+            stack[(*stack_len)++] = (u32)(r * board->width + c);
+        }
+        if (reveal) {
+            board_set_state(board, cell, CELL_EXPLORED);
+            if (reveal_start < 0) {
+                reveal_start = c;
+            }
+        } else if (reveal_start >= 0) {
+            if (engine->span_fn) {
+                engine->span_fn(engine->span_data, (u32)r, (u32)reveal_start, (u32)(c - 1));
+            }
+            reveal_start = -1;
+        }
+    }
+    if (reveal_start >= 0 && engine->span_fn) {
+        engine->span_fn(engine->span_data, (u32)r, (u32)reveal_start, (u32)c1);
+    }
+}
+
+/*
+ * Scanline flood fill out from an empty cell
+ * Every seed on the stack is a revealed empty cell; popping one grows it
+ * into the full run of empty cells on its row, reveals that run and its
+ * two ends, then scans the rows above and below (one cell wider each
+ * side, for diagonals) for numbers to reveal and empty runs to seed
+ * The border stops every scan, so none of them check for the edges
+ */
+static void flood_fill(Engine *engine, u32 start_c, u32 start_r)
+{
+    Board *board = &engine->board;
+    u32 *stack = board->fill_stack;
+    u32 stack_len = 0;
+
+    reveal_span(engine, start_r, start_c, start_c);
+    stack[stack_len++] = start_r * board->width + start_c;
+
+    while (stack_len) {
+        u32 idx = stack[--stack_len];
+        u32 r = idx / board->width;
+        u32 c = idx - r * board->width;
+        Cell *row = board_pos_to_cell(board, 0, r);
+
+        ASSERT(row[c].state == CELL_EXPLORED);
+        ASSERT(row[c].bombs_around == 0);
+
+        i64 left = c;
+        while (is_unexplored_empty(&row[left - 1])) {
+            left--;
+        }
+        i64 right = c;
+        while (is_unexplored_empty(&row[right + 1])) {
+            right++;
+        }
+        if (left < c) {
+            reveal_span(engine, r, (u32)left, c - 1);
+        }
+        if (right > c) {
+            reveal_span(engine, r, c + 1, (u32)right);
+        }
+        // the ends are numbers, flags, already explored or the border
+        if (row[left - 1].state == CELL_UNEXPLORED) {
+            reveal_span(engine, r, (u32)(left - 1), (u32)(left - 1));
+        }
+        if (row[right + 1].state == CELL_UNEXPLORED) {
+            reveal_span(engine, r, (u32)(right + 1), (u32)(right + 1));
+        }
+
+        fill_scan_row(engine, (i64)r - 1, left - 1, right + 1, stack, &stack_len);
+        fill_scan_row(engine, (i64)r + 1, left - 1, right + 1, stack, &stack_len);
+    }
+}
+
+static void explore(Engine *engine, Cell *cell)
+{
+    Board *board = &engine->board;
+
+    ASSERT(cell);
+    ASSERT(cell->state == CELL_UNEXPLORED);
+
+    i64 c, r;
+    board_cell_to_pos(board, cell, &c, &r);
+
+    if (cell->is_bomb) {
+        // lose the game
+        engine->status = ENGINE_LOST;
+        board->bomb_clicked = board_pos_to_idx(board, c, r);
+        reveal_span(engine, (u32)r, (u32)c, (u32)c);
+        // idk why but bombs under flags don't show
+        if (board->use_bits) {
+            bitboard_for_each_and_not(&board->bits, BITPLANE_BOMB, BITPLANE_FLAGGED, reveal_bomb, engine);
+            return;
+        }
+        for (u32 br = 0; br < board->height; ++br) {
+            Cell *row = board_pos_to_cell(board, 0, br);
+            for (u32 bc = 0; bc < board->width; ++bc) {
+                Cell *b_cell = &row[bc];
+                if (b_cell->is_bomb && b_cell->state != CELL_FLAGGED && b_cell->state != CELL_EXPLORED) {
+                    reveal_span(engine, br, bc, bc);
+                }
+            }
+        }
+        return;
+    }
+
+    if (cell->bombs_around > 0) {
+        // no searching needed
+        reveal_span(engine, (u32)r, (u32)c, (u32)c);
+    } else {
+        flood_fill(engine, (u32)c, (u32)r);
+    }
+    check_if_won(engine);
+}
+
+/*
+ * Rectangle of cells bombs can't go in, r0..r1 and c0..c1 inclusive
+ * Empty if r1 < r0
+ */
+typedef struct {
+    u32 c0;
+    u32 c1;
+    u32 r0;
+    u32 r1;
+} ExcludeZone;
+
+static const ExcludeZone exclude_none = { 0, 0, 1, 0 };
+
+static u64 exclude_zone_cells(ExcludeZone *zone)
+{
+    if (zone->r1 < zone->r0) {
+        return 0;
+    }
+    return ((u64)zone->c1 - zone->c0 + 1) * ((u64)zone->r1 - zone->r0 + 1);
+}
+
+/*
+ * The k-th cell outside the zone, in index order
+ * The zone is one run of cells per row, so step k over each run before it
+ */
+static u64 allowed_cell_idx(Board *board, ExcludeZone *zone, u64 k)
+{
+    for (u32 r = zone->r0; r <= zone->r1; ++r) {
+        u64 run_start = (u64)r * board->width + zone->c0;
+        if (k < run_start) {
+            break;
+        }
+        k += zone->c1 - zone->c0 + 1;
+    }
+    return k;
+}
+
+/*
+ * The 3x3 square around the first click, so it always opens up
+ * If that leaves too few cells for the bombs, just the clicked cell
+ */
+static ExcludeZone first_click_zone(Board *board, u32 c, u32 r)
+{
+    ExcludeZone zone = {
+        c > 0 ? c - 1 : 0,
+        MIN(c + 1, board->width - 1),
+        r > 0 ? r - 1 : 0,
+        MIN(r + 1, board->height - 1),
+    };
+    if (board->num_cells - exclude_zone_cells(&zone) < board->num_bombs) {
+        zone.c0 = zone.c1 = c;
+        zone.r0 = zone.r1 = r;
+    }
+    return zone;
+}
+
+static void set_bomb(Board *board, u8 *bomb_mask, u64 idx, bool is_bomb)
+{
+    i64 c, r;
+    board_idx_to_pos(board, idx, &c, &r);
+    board_pos_to_cell(board, c, r)->is_bomb = is_bomb;
+    if (board->use_bits) {
+        bitboard_set(&board->bits, BITPLANE_BOMB, (u32)c, (u32)r, is_bomb);
+    }
+    if (bomb_mask) {
+        *boxsum_mask_cell(bomb_mask, board->width, (u32)c, (u32)r) = is_bomb;
+    }
+}
+
+/*
+ * Place num_bombs bombs uniformly outside zone, then count bombs_around
+ *
+ * Floyd's sampling picks k distinct cells out of n with exactly k random
+ * draws and no retries, using the cells' own is_bomb bits as the set
+ * Above 50% density it's cheaper to pick the safe cells instead: fill
+ * everything with bombs, then pick the n - k cells to clear
+ */
+static bool place_bombs(Engine *engine, ExcludeZone zone)
+{
+    Board *board = &engine->board;
+    u32 width = board->width;
+
+    u64 num_allowed = board->num_cells - exclude_zone_cells(&zone);
+    ASSERT(board->num_bombs <= num_allowed);
+
+    /*
+     * Count with a box sum over a padded byte mask, even with bitplanes to
+     * hand: the SSE2/AVX2 kernels take ~0.2ns a cell to the bitplane
+     * adders' ~3ns (bench counts), which pays for filling the mask too
+     * Only with just the scalar kernel do the bitplanes count instead
+     * Either way counts come out a row at a time, since bombs_around is
+     * a bitfield we can't write to directly
+     * The mask and row are only needed here, so hand their arena space back after
+     */
+    u32 kernel = boxsum_best_kernel();
+    bool count_bits = board->use_bits && kernel == BOXSUM_SCALAR;
+    void *arena_mark = engine->arena.next_free;
+    u8 *bomb_mask = NULL;
+    u8 *row_counts = engine_alloc(engine, width);
+    if (!row_counts) {
+        log_error("Failed to allocate bomb counts");
+        return false;
+    }
+    if (!count_bits) {
+        bomb_mask = engine_alloc(engine, boxsum_mask_size(width, board->height));
+        if (!bomb_mask) {
+            log_error("Failed to allocate bomb mask");
+            return false;
+        }
+        memset(bomb_mask, 0, boxsum_mask_size(width, board->height));
+    }
+
+    // picking safe cells instead of bombs
+    bool complement = board->num_bombs > num_allowed / 2;
+    u64 num_picks = complement ? num_allowed - board->num_bombs : board->num_bombs;
+    if (complement) {
+        for (u64 k = 0; k < num_allowed; ++k) {
+            set_bomb(board, bomb_mask, allowed_cell_idx(board, &zone, k), true);
+        }
+    }
+    for (u64 j = num_allowed - num_picks; j < num_allowed; ++j) {
+        u64 idx = allowed_cell_idx(board, &zone, rng_below(&engine->rng, j + 1));
+        // already picked, so take j; it can't have been picked yet
+        if (board_idx_to_cell(board, idx)->is_bomb != complement) {
+            idx = allowed_cell_idx(board, &zone, j);
+        }
+        set_bomb(board, bomb_mask, idx, !complement);
+    }
+
+    // bombs all get 0 for bombs_around
+    for (u32 r = 0; r < board->height; ++r) {
+        if (count_bits) {
+            bitboard_count_neighbours_row(&board->bits, r, row_counts);
+        } else {
+            // the mask rows around board row r start at padded row r
+            boxsum_count(kernel, &bomb_mask[(u64)r * ((u64)width + 2)], width, 1, row_counts);
+        }
+        Cell *row = board_pos_to_cell(board, 0, r);
+        for (u32 c = 0; c < width; ++c) {
+            row[c].bombs_around = row_counts[c];
+        }
+    }
+    engine->arena.next_free = arena_mark;
+    board->bombs_placed = true;
+    board->changes.all = true;
+
+    return true;
+}
+
+static u32 board_changes_capacity(u64 num_cells)
+{
+    return (u32)MIN(num_cells, ENGINE_MAX_CHANGES);
+}
+
+// a new board starts with everything changed
+static bool board_init_changes(Engine *engine)
+{
+    ChangeList *changes = &engine->board.changes;
+    changes->capacity = board_changes_capacity(engine->board.num_cells);
+    changes->idxs = engine_alloc(engine, changes->capacity * sizeof(u32));
+    changes->num = 0;
+    changes->all = true;
+    return changes->idxs != NULL;
+}
+
+static bool board_init(Engine *engine, u32 width, u32 height, u32 num_bombs)
+{
+    Board *board = &engine->board;
+
+    u64 num_cells = (u64)width * (u64)height;
+    ASSERT(num_cells <= ENGINE_MAX_CELLS);
+    ASSERT(num_bombs < num_cells);
+
+    board->width = width;
+    board->height = height;
+    board->bombs_left = (i64)num_bombs;
+    board->num_bombs = num_bombs;
+    board->num_cells = num_cells;
+    board->num_safe_explored = 0;
+    // snapshot layout first (see EngineSnapshot), then everything that isn't saved
+    board->snapshot = engine_alloc(engine, sizeof(EngineSnapshot));
+    u64 grid_cells = board_grid_cells(width, height);
+    Cell *grid = engine_alloc(engine, grid_cells * sizeof(Cell));
+    if (!board->snapshot || !grid) {
+        log_error("Failed to allocate board");
+        return false;
+    }
+    memset(board->snapshot, 0, sizeof(EngineSnapshot));
+    memset(grid, 0, grid_cells * sizeof(Cell));
+    board_set_grid(board, grid);
+    for (i64 c = -1; c <= (i64)width; ++c) {
+        board->cells[c - (i64)board->stride] = cell_border;
+        board->cells[(i64)height * board->stride + c] = cell_border;
+    }
+    for (u32 r = 0; r < height; ++r) {
+        Cell *row = board_pos_to_cell(board, 0, r);
+        row[-1] = cell_border;
+        row[width] = cell_border;
+    }
+    board->use_bits = engine->flags & ENGINE_FLAG_BITPLANES;
+    if (board->use_bits) {
+        void *bits_mem = engine_alloc(engine, bitboard_mem_size(width, height));
+        if (!bits_mem) {
+            log_error("Failed to allocate bitplanes");
+            return false;
+        }
+        bitboard_init(&board->bits, width, height, bits_mem);
+    }
+    board->fill_stack = engine_alloc(engine, num_cells * sizeof(u32));
+    if (!board->fill_stack || !board_init_changes(engine)) {
+        log_error("Failed to allocate board");
+        return false;
+    }
+    board->cell_last_clicked = BOARD_NO_CELL;
+    board->bomb_clicked = BOARD_NO_CELL;
+    board->bombs_placed = false;
+    board->undo = NULL;
+
+    // otherwise wait for the first reveal to know where to keep clear
+    if (!(engine->flags & ENGINE_FLAG_SAFE_FIRST_CLICK)) {
+        return place_bombs(engine, exclude_none);
+    }
+
+    return true;
+}
+
+u64 engine_mem_size(u32 width, u32 height)
+{
+    u64 num_cells = (u64)width * (u64)height;
+    return ALIGN_UP_POW_2(sizeof(EngineSnapshot), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(board_grid_cells(width, height) * sizeof(Cell), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(num_cells * sizeof(u32), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(board_changes_capacity(num_cells) * sizeof(u32), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(width, ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(bitboard_mem_size(width, height), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(boxsum_mask_size(width, height), ENGINE_ALIGN);
+}
+
+void engine_init(Engine *engine, u64 seed, u32 flags)
+{
+    ASSERT(engine);
+
+    memset(engine, 0, sizeof(*engine));
+    rng_seed(&engine->seed_rng, seed);
+    engine->flags = flags;
+    engine->time_started_ms = ENGINE_TIME_NONE;
+    engine->time_ms = ENGINE_TIME_NONE;
+    // nothing to play until engine_new_game()
+    engine->status = ENGINE_LOST;
+}
+
+bool engine_new_game(Engine *engine, GameParams params, void *mem, u64 mem_size)
+{
+    ASSERT(engine);
+    ASSERT(mem);
+    ASSERT(mem_size >= engine_mem_size(params.width, params.height));
+    // bump allocations are only aligned if the base is
+    ASSERT(ALIGN_UP_POW_2(mem, ENGINE_ALIGN) == (u64)mem);
+
+    if ((u64)params.width * (u64)params.height > ENGINE_MAX_CELLS) {
+        log_error("Board too big: %ux%u", params.width, params.height);
+        return false;
+    }
+
+    CHECK_LOG(bump_init_allocator(&engine->arena, mem, mem_size), false, "Failed to init engine arena");
+
+    while (params.seed == 0) {
+        params.seed = rng_next(&engine->seed_rng);
+    }
+    rng_seed(&engine->rng, params.seed);
+    if (!board_init(engine, params.width, params.height, params.num_bombs)) {
+        log_error("Failed to init board");
+        return false;
+    }
+    engine->params = params;
+    engine->time_started_ms = ENGINE_TIME_NONE;
+    engine->time_ms = ENGINE_TIME_NONE;
+    engine->status = ENGINE_PLAYING;
+    engine_undo_clear(engine);
+
+    return true;
+}
+
+void engine_tick(Engine *engine, u64 now_ms)
+{
+    ASSERT(engine);
+
+    if (engine->status == ENGINE_PLAYING && engine->time_started_ms != ENGINE_TIME_NONE) {
+        engine->time_ms = now_ms;
+    }
+}
+
+void engine_clear_changes(Engine *engine)
+{
+    ASSERT(engine);
+
+    engine->board.changes.num = 0;
+    engine->board.changes.all = false;
+}
+
+bool engine_press(Engine *engine, u32 c, u32 r)
+{
+    ASSERT(engine);
+
+    Board *board = &engine->board;
+    Cell *cell = board_pos_to_cell(board, c, r);
+
+    if (engine->status != ENGINE_PLAYING || cell->state != CELL_UNEXPLORED) {
+        return false;
+    }
+    board_set_state(board, cell, CELL_CLICKED);
+    board->cell_last_clicked = board_pos_to_idx(board, c, r);
+
+    return true;
+}
+
+void engine_release_press(Engine *engine)
+{
+    ASSERT(engine);
+
+    Board *board = &engine->board;
+    if (board->cell_last_clicked == BOARD_NO_CELL) {
+        return;
+    }
+    Cell *cell = board_idx_to_cell(board, board->cell_last_clicked);
+    if (cell->state == CELL_CLICKED) {
+        board_set_state(board, cell, CELL_UNEXPLORED);
+    }
+}
+
+bool engine_reveal(Engine *engine, u32 c, u32 r, u64 now_ms)
+{
+    ASSERT(engine);
+
+    Board *board = &engine->board;
+    Cell *cell = board_pos_to_cell(board, c, r);
+
+    if (engine->status != ENGINE_PLAYING || cell->state != CELL_UNEXPLORED) {
+        return false;
+    }
+    if (!board->bombs_placed && !place_bombs(engine, first_click_zone(board, c, r))) {
+        log_error("Failed to place bombs");
+        return false;
+    }
+    undo_begin_move(engine);
+    explore(engine, cell);
+    undo_end_move(engine);
+    // start timer
+    if (engine->time_started_ms == ENGINE_TIME_NONE) {
+        engine->time_started_ms = now_ms;
+        engine->time_ms = now_ms;
+    }
+
+    return true;
+}
+
+bool engine_toggle_flag(Engine *engine, u32 c, u32 r)
+{
+    ASSERT(engine);
+
+    Board *board = &engine->board;
+    Cell *cell = board_pos_to_cell(board, c, r);
+
+    if (engine->status != ENGINE_PLAYING) {
+        return false;
+    }
+    if (cell->state != CELL_UNEXPLORED && cell->state != CELL_FLAGGED) {
+        return false;
+    }
+    undo_begin_move(engine);
+    board_set_state(board, cell, cell->state == CELL_FLAGGED ? CELL_UNEXPLORED : CELL_FLAGGED);
+    undo_end_move(engine);
+
+    return true;
+}
+
+u64 engine_undo_mem_size(u32 max_deltas)
+{
+    // every move changes at least one cell, but allow for lots of small ones
+    u64 max_moves = (u64)max_deltas / 2 + 1;
+    return ALIGN_UP_POW_2((u64)max_deltas * sizeof(u32), ENGINE_ALIGN) +
+           ALIGN_UP_POW_2(max_moves * sizeof(UndoMove), ENGINE_ALIGN);
+}
+
+bool engine_undo_init(Engine *engine, u32 max_deltas, void *mem, u64 mem_size)
+{
+    ASSERT(engine);
+    ASSERT(mem);
+    ASSERT(max_deltas > 0);
+
+    UndoLog *log = &engine->undo;
+    CHECK_LOG(mem_size >= engine_undo_mem_size(max_deltas), false,
+              "Undo log needs %" PRIu64 " bytes, got %" PRIu64, engine_undo_mem_size(max_deltas), mem_size);
+    if (engine->board.num_cells > ENGINE_UNDO_MAX_CELLS) {
+        log_error("Board too big to undo: %" PRIu64 " cells", engine->board.num_cells);
+        return false;
+    }
+    log->deltas = (u32 *)mem;
+    log->moves = (UndoMove *)((u8 *)mem + ALIGN_UP_POW_2((u64)max_deltas * sizeof(u32), ENGINE_ALIGN));
+    log->max_deltas = max_deltas;
+    log->max_moves = max_deltas / 2 + 1;
+    engine_undo_clear(engine);
+
+    return true;
+}
+
+void engine_undo_clear(Engine *engine)
+{
+    ASSERT(engine);
+
+    UndoLog *log = &engine->undo;
+    log->num_deltas = 0;
+    log->end_deltas = 0;
+    log->num_moves = 0;
+    log->end_moves = 0;
+    log->recording = false;
+    log->overflowed = false;
+}
+
+bool engine_undo(Engine *engine)
+{
+    ASSERT(engine);
+
+    UndoLog *log = &engine->undo;
+    Board *board = &engine->board;
+    if (log->num_moves == 0) {
+        return false;
+    }
+    ASSERT(!log->recording);
+    engine_release_press(engine);
+
+    UndoMove *move = &log->moves[log->num_moves - 1];
+    for (u32 i = log->num_deltas; i > move->first_delta; --i) {
+        u32 delta = log->deltas[i - 1];
+        Cell *cell = board_idx_to_cell(board, UNDO_DELTA_IDX(delta));
+        ASSERT(cell->state == UNDO_DELTA_NEW(delta));
+        board_set_state(board, cell, UNDO_DELTA_OLD(delta));
+    }
+    log->num_deltas = move->first_delta;
+    log->num_moves--;
+    // moves are only made while playing
+    engine->status = ENGINE_PLAYING;
+    board->bomb_clicked = BOARD_NO_CELL;
+
+    return true;
+}
+
+bool engine_redo(Engine *engine)
+{
+    ASSERT(engine);
+
+    UndoLog *log = &engine->undo;
+    Board *board = &engine->board;
+    if (log->num_moves == log->end_moves) {
+        return false;
+    }
+    ASSERT(!log->recording);
+    engine_release_press(engine);
+
+    UndoMove *move = &log->moves[log->num_moves];
+    u32 end = log->num_moves + 1 < log->end_moves ? move[1].first_delta : log->end_deltas;
+    for (u32 i = move->first_delta; i < end; ++i) {
+        u32 delta = log->deltas[i];
+        Cell *cell = board_idx_to_cell(board, UNDO_DELTA_IDX(delta));
+        ASSERT(cell->state == UNDO_DELTA_OLD(delta));
+        board_set_state(board, cell, UNDO_DELTA_NEW(delta));
+    }
+    log->num_deltas = end;
+    log->num_moves++;
+    engine->status = move->status;
+    if (engine->status == ENGINE_LOST) {
+        // a losing move starts with the bomb that was clicked, see explore()
+        board->bomb_clicked = UNDO_DELTA_IDX(log->deltas[move->first_delta]);
+    }
+
+    return true;
+}
+
+u64 engine_undo_mem_used(Engine *engine)
+{
+    ASSERT(engine);
+    return (u64)engine->undo.end_deltas * sizeof(u32) +
+           (u64)engine->undo.end_moves * sizeof(UndoMove);
+}
+
+EngineSnapshot *engine_snapshot(Engine *engine, u64 now_ms, u64 *size)
+{
+    ASSERT(engine);
+    ASSERT(size);
+
+    Board *board = &engine->board;
+    EngineSnapshot *snap = board->snapshot;
+    ASSERT(snap);
+
+    snap->magic = ENGINE_SNAPSHOT_MAGIC;
+    snap->version = ENGINE_SNAPSHOT_VERSION;
+    snap->header_size = sizeof(EngineSnapshot);
+    snap->status = engine->status;
+    snap->width = board->width;
+    snap->height = board->height;
+    snap->num_bombs = board->num_bombs;
+    snap->bombs_placed = board->bombs_placed;
+    snap->seed = engine->params.seed;
+    snap->num_cells = board->num_cells;
+    snap->cells_offset = (u64)((u8 *)(board->cells - board->stride - 1) - (u8 *)snap);
+    snap->bits_offset = board->use_bits ? (u64)((u8 *)board->bits.planes[0] - (u8 *)snap) : 0;
+    snap->size = board->use_bits ? snap->bits_offset + bitboard_mem_size(board->width, board->height)
+                                 : snap->cells_offset + board_grid_cells(board->width, board->height) * sizeof(Cell);
+    snap->bombs_left = board->bombs_left;
+    snap->num_safe_explored = board->num_safe_explored;
+    snap->time_elapsed_ms = ENGINE_TIME_NONE;
+    if (engine->time_started_ms != ENGINE_TIME_NONE) {
+        // a running timer is only as fresh as the last tick
+        u64 time_ms = engine->status == ENGINE_PLAYING ? MAX(now_ms, engine->time_ms) : engine->time_ms;
+        snap->time_elapsed_ms = time_ms - engine->time_started_ms;
+    }
+    snap->cell_last_clicked = board->cell_last_clicked == BOARD_NO_CELL ? ENGINE_SNAPSHOT_NO_CELL
+                                                                        : board->cell_last_clicked;
+    snap->bomb_clicked = board->bomb_clicked == BOARD_NO_CELL ? ENGINE_SNAPSHOT_NO_CELL
+                                                              : board->bomb_clicked;
+    snap->rng = engine->rng;
+
+    *size = snap->size;
+    return snap;
+}
+
+bool engine_snapshot_valid(void *snapshot, u64 size)
+{
+    ASSERT(snapshot);
+
+    EngineSnapshot *snap = (EngineSnapshot *)snapshot;
+    CHECK_LOG(size >= sizeof(EngineSnapshot) && snap->magic == ENGINE_SNAPSHOT_MAGIC,
+              false, "Not a snapshot");
+    CHECK_LOG(snap->version == ENGINE_SNAPSHOT_VERSION && snap->header_size == sizeof(EngineSnapshot),
+              false, "Unsupported snapshot version %u", snap->version);
+    CHECK_LOG(snap->size <= size, false, "Snapshot truncated");
+
+    u64 num_cells = (u64)snap->width * (u64)snap->height;
+    CHECK_LOG(num_cells > 0 && num_cells <= ENGINE_MAX_CELLS && snap->num_cells == num_cells &&
+              snap->num_bombs < num_cells, false, "Bad snapshot board size");
+    u64 grid_size = board_grid_cells(snap->width, snap->height) * sizeof(Cell);
+    CHECK_LOG(snap->cells_offset >= sizeof(EngineSnapshot) && snap->cells_offset % ENGINE_ALIGN == 0 &&
+              snap->cells_offset <= snap->size && grid_size <= snap->size - snap->cells_offset,
+              false, "Bad snapshot cells");
+    if (snap->bits_offset) {
+        CHECK_LOG(snap->bits_offset >= snap->cells_offset + grid_size &&
+                  snap->bits_offset % ENGINE_ALIGN == 0 && snap->bits_offset <= snap->size &&
+                  bitboard_mem_size(snap->width, snap->height) <= snap->size - snap->bits_offset,
+                  false, "Bad snapshot bitplanes");
+    }
+    CHECK_LOG(snap->status <= ENGINE_LOST &&
+              (snap->cell_last_clicked < num_cells || snap->cell_last_clicked == ENGINE_SNAPSHOT_NO_CELL) &&
+              (snap->bomb_clicked < num_cells || snap->bomb_clicked == ENGINE_SNAPSHOT_NO_CELL) &&
+              snap->num_safe_explored <= num_cells - snap->num_bombs,
+              false, "Bad snapshot state");
+
+    // nothing checks for the edges, so the border has to be intact
+    Cell *grid = (Cell *)((u8 *)snap + snap->cells_offset);
+    u64 stride = (u64)snap->width + 2;
+    u64 last_row = ((u64)snap->height + 1) * stride;
+    for (u64 c = 0; c < stride; ++c) {
+        CHECK_LOG(cell_is_border(&grid[c]) && cell_is_border(&grid[last_row + c]),
+                  false, "Bad snapshot border");
+    }
+    for (u64 r = 1; r <= snap->height; ++r) {
+        CHECK_LOG(cell_is_border(&grid[r * stride]) && cell_is_border(&grid[r * stride + stride - 1]),
+                  false, "Bad snapshot border");
+    }
+
+    /*
+     * The counts are used as saved, so they have to add up, or the game
+     * could never be won. The bitplanes are too, and are counted a word at
+     * a time; they're trusted to match the cells, which only a hand edited
+     * file could break, and then only the game and not the engine's bounds
+     */
+    u64 num_bombs = 0;
+    u64 num_flagged = 0;
+    u64 num_safe_explored = 0;
+    if (snap->bits_offset) {
+        BitBoard bits;
+        bitboard_attach(&bits, snap->width, snap->height, (u8 *)snap + snap->bits_offset);
+        CHECK_LOG(bitboard_padding_clear(&bits), false, "Bad snapshot bitplanes");
+        num_bombs = bitboard_popcount(&bits, BITPLANE_BOMB);
+        num_flagged = bitboard_popcount(&bits, BITPLANE_FLAGGED);
+        num_safe_explored = bitboard_popcount_and_not(&bits, BITPLANE_EXPLORED, BITPLANE_BOMB);
+    } else {
+        for (u64 r = 1; r <= snap->height; ++r) {
+            Cell *row = &grid[r * stride + 1];
+            for (u64 c = 0; c < snap->width; ++c) {
+                num_bombs += row[c].is_bomb;
+                num_flagged += row[c].state == CELL_FLAGGED;
+                num_safe_explored += !row[c].is_bomb && row[c].state == CELL_EXPLORED;
+            }
+        }
+    }
+    u64 num_bombs_expected = snap->bombs_placed ? snap->num_bombs : 0;
+    CHECK_LOG(num_bombs == num_bombs_expected, false, "Snapshot has %" PRIu64 " bombs, expected %" PRIu64,
+              num_bombs, num_bombs_expected);
+    CHECK_LOG(snap->num_safe_explored == num_safe_explored &&
+              snap->bombs_left == (i64)snap->num_bombs - (i64)num_flagged,
+              false, "Bad snapshot counts");
+    return true;
+}
+
+bool engine_load_snapshot(Engine *engine, void *snapshot, u64 snapshot_size, u64 now_ms,
+                          void *mem, u64 mem_size)
+{
+    ASSERT(engine);
+    ASSERT(snapshot);
+    ASSERT(mem);
+    ASSERT(ALIGN_UP_POW_2(snapshot, ENGINE_ALIGN) == (u64)snapshot);
+    ASSERT(ALIGN_UP_POW_2(mem, ENGINE_ALIGN) == (u64)mem);
+
+    EngineSnapshot *snap = (EngineSnapshot *)snapshot;
+    // checked by the caller, before anything was given up for it
+    ASSERT(engine_snapshot_valid(snap, snapshot_size));
+    (void)snapshot_size;
+    ASSERT(mem_size >= engine_mem_size(snap->width, snap->height));
+    CHECK_LOG(bump_init_allocator(&engine->arena, mem, mem_size), false, "Failed to init engine arena");
+
+    Board *board = &engine->board;
+    board->width = snap->width;
+    board->height = snap->height;
+    board->num_cells = snap->num_cells;
+    board->num_bombs = snap->num_bombs;
+    board->bombs_left = snap->bombs_left;
+    board->num_safe_explored = snap->num_safe_explored;
+    board->bombs_placed = snap->bombs_placed;
+    board->snapshot = snap;
+    board_set_grid(board, (Cell *)((u8 *)snap + snap->cells_offset));
+    board->use_bits = snap->bits_offset != 0;
+    if (board->use_bits) {
+        bitboard_attach(&board->bits, board->width, board->height, (u8 *)snap + snap->bits_offset);
+    }
+    board->fill_stack = engine_alloc(engine, board->num_cells * sizeof(u32));
+    if (!board->fill_stack || !board_init_changes(engine)) {
+        log_error("Failed to allocate board");
+        return false;
+    }
+    board->cell_last_clicked = snap->cell_last_clicked == ENGINE_SNAPSHOT_NO_CELL ? BOARD_NO_CELL
+                                                                                  : (u32)snap->cell_last_clicked;
+    board->bomb_clicked = snap->bomb_clicked == ENGINE_SNAPSHOT_NO_CELL ? BOARD_NO_CELL
+                                                                        : (u32)snap->bomb_clicked;
+    board->undo = NULL;
+
+    engine->params.width = snap->width;
+    engine->params.height = snap->height;
+    engine->params.num_bombs = snap->num_bombs;
+    engine->params.seed = snap->seed;
+    engine->rng = snap->rng;
+    engine->status = (u8)snap->status;
+    engine->time_started_ms = ENGINE_TIME_NONE;
+    engine->time_ms = ENGINE_TIME_NONE;
+    if (snap->time_elapsed_ms != ENGINE_TIME_NONE) {
+        engine->time_started_ms = now_ms - MIN(snap->time_elapsed_ms, now_ms);
+        engine->time_ms = engine->time_started_ms + snap->time_elapsed_ms;
+    }
+    engine_undo_clear(engine);
+
+    return true;
+}
+
+C_END
@@ -76,6 +76,30 @@ err_close_file:
     return NULL;
 }
 
+bool file_write(const char *filename, const void *data, u64 len)
+{
+    ASSERT(filename);
+    ASSERT(data || len == 0);
+
+    SDL_RWops *file = SDL_RWFromFile(filename, "wb");
+    if (file == NULL) {
+        log_error("SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    bool ok = true;
+    if (len > 0 && SDL_RWwrite(file, data, len, 1) != 1) {
+        log_error("SDL Error: %s\n", SDL_GetError());
+        ok = false;
+    }
+    if (SDL_RWclose(file)) {
+        log_error("SDL Error: %s\n", SDL_GetError());
+        ok = false;
+    }
+
+    return ok;
+}
+
 unsigned char *image_file_read(const char *filename, u64 *size, u32 *width, u32 *height)
 {
     u64 len = 0;
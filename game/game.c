@@ -1,7 +1,6 @@
-// TODO remove these, needed for srand, rand
-#include<stdlib.h>
+// TODO remove this, needed for time() to seed the engine
 #include<time.h>
-#include<string.h> // memset
+#include<math.h>
 
 #include<SDL.h>
 #include"types.h"
@@ -9,16 +8,38 @@
 #include"log.h"
 #include"render.h"
 #include"mem.h"
+#include"file.h"
+#include"engine.h"
+#include"job.h"
+#include"noguess.h"
+#include"rng.h"
 #include"game.h"
 
 GameState game_state;
 
+// candidates to try for a no-guess board before settling for a regular one
+#define GAME_NO_GUESS_MAX_CANDIDATES 100000
+#define GAME_JOB_DEQUE_CAPACITY 256
+/*
+ * Cell changes the undo log can hold; enough for a few openings of a big
+ * board without taking much of the scratch budget
+ */
+#define GAME_UNDO_MAX_DELTAS (1 << 22)
+// most events are 2-4 bytes, so this is hours of constant mouse movement
+#define GAME_REPLAY_MAX_BYTES MiB(16)
+#define GAME_SAVE_PATH "save.bsnap"
+
 static bool game_needs_restart = false;
 #ifdef DEBUG
 static bool show_debug = false;
 #endif
 
 static bool game_start(GameParams params);
+static bool game_save(const char *path);
+static bool game_load(const char *path);
+static void no_guess_start_board();
+static void no_guess_use_board(u64 seed);
+static bool game_board_deal(u32 i);
 
 enum {
     MOUSE_NONE = 0,
@@ -27,110 +48,63 @@ enum {
     MOUSE_RIGHT_RELEASED
 };
 
-void check_if_won(Board *board)
+// keep the view on the play area, and the zoom in range
+static void camera_clamp(Camera *camera)
 {
-    u32 num_explored = 0;
-    for (u32 i = 0; i < board->num_cells; ++i) {
-        Cell *cell = &board->cells[i];
-        if (cell->state == CELL_EXPLORED) {
-            ASSERT(!cell->is_bomb);
-            num_explored++;
-        }
-    }
-    if (num_explored == board->num_cells - board->num_bombs) {
-        game_state.playing = false;
-        game_state.face_state = FACE_COOL;
-    }
+    Vec2f view_dims = view_dims_px();
+    f32 area_width = (f32)play_area_cols() * CELL_PIXEL_WIDTH;
+    f32 area_height = (f32)play_area_rows() * CELL_PIXEL_HEIGHT;
+    // no further out than the whole play area fitting the view
+    f32 fit = MIN(view_dims.x / area_width, view_dims.y / area_height);
+    f32 zoom_min = MAX(CAMERA_ZOOM_MIN, MIN(1.0F, fit));
+    camera->zoom = CLAMP(camera->zoom, zoom_min, CAMERA_ZOOM_MAX);
+
+    f32 max_x = MAX(area_width - view_dims.x / camera->zoom, 0.0F);
+    f32 max_y = MAX(area_height - view_dims.y / camera->zoom, 0.0F);
+    camera->pos.x = CLAMP(camera->pos.x, 0.0F, max_x);
+    camera->pos.y = CLAMP(camera->pos.y, 0.0F, max_y);
 }
 
-static void explore(Board *board, Cell *cell)
+// zoom by factor, keeping the play area pixel under pos (game pixels) where it is
+static void camera_zoom_at(Camera *camera, Vec2f pos, f32 factor)
 {
-    ASSERT(board);
-    ASSERT(cell);
-    ASSERT(cell->state == CELL_UNEXPLORED);
-
-    cell->state = CELL_EXPLORED;
-
-    if (cell->is_bomb) {
-        // lose the game
-        game_state.face_state = FACE_DEAD;
-        board->bomb_clicked = cell;
-        game_state.playing = false;
-        for (u32 i = 0; i < board->num_cells; ++i) {
-            Cell *b_cell = &board->cells[i];
-            // idk why but bombs under flags don't show
-            if (b_cell->is_bomb && b_cell->state != CELL_FLAGGED) {
-                b_cell->state = CELL_EXPLORED;
-            }
-        }
-        return;
-    } else if (cell->bombs_around > 0) {
-        check_if_won(board);
-        // early exit instead of searching
-        return;
-    }
+    Vec2f offset = cells_offset_px();
+    Vec2f board_pos = camera_to_play_area_px(pos);
+    camera->zoom *= factor;
+    camera_clamp(camera);
+    camera->pos.x = board_pos.x - (pos.x - offset.x) / camera->zoom;
+    camera->pos.y = board_pos.y - (pos.y - offset.y) / camera->zoom;
+    camera_clamp(camera);
+}
 
-    // err just ad hoc it
-    u32 q_head = 0;
-    u32 q_tail = 0;
-    u32 q_len = 0;
-    u32 q_size = board->num_cells;
-    Cell **frontier = mem_alloc(sizeof(Cell *) * board->num_cells);
-    if (frontier == NULL) {
-        log_error("Failed to alloc frontier");
-        return;
-    }
-    memset(frontier, 0, sizeof(Cell *) * board->num_cells);
-
-    frontier[0] = cell;
-    q_tail++;
-    q_len++;
-    while(q_len) {
-        // pop queue
-        Cell *curr = frontier[q_head];
-        q_head = (q_head + 1) % q_size;
-        q_len--;
-        if (curr->bombs_around > 0) {
-            continue;
-        }
-        i64 curr_r,curr_c;
-        board_cell_to_pos(board, curr, &curr_c, &curr_r);
-        for (i64 r = curr_r - 1; r <= curr_r + 1; ++r) {
-            if (r < 0 || r >= board->height) {
-                continue;
-            }
-            for (i64 c = curr_c - 1; c <= curr_c + 1; ++c) {
-                if (c < 0 || c >= board->width) {
-                    continue;
-                }
-                if (c == curr_c && r == curr_r) {
-                    continue;
-                }
-                Cell *neighbor = board_pos_to_cell(board, c, r);
-                ASSERT(!neighbor->is_bomb);
-                // if cell is flagged, don't explore it
-                if (neighbor->state == CELL_UNEXPLORED) {
-                    neighbor->state = CELL_EXPLORED;
-                    //log_error("add %u %u", c, r);
-                    // TODO expand queue... should be big enough though
-                    ASSERT(q_len < q_size - 1);
-                    frontier[q_tail] = neighbor;
-                    q_tail = (q_tail + 1) % q_size;
-                    q_len++;
-                }
-            }
+// the face for how the boards stand; dead or cool once none are left to play
+static u8 face_for_boards()
+{
+    bool lost = false;
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        Engine *engine = game_engine(i);
+        if (engine->status == ENGINE_PLAYING) {
+            return FACE_SMILE;
         }
+        lost = lost || engine->status == ENGINE_LOST;
     }
-    check_if_won(board);
+    return lost ? FACE_DEAD : FACE_COOL;
 }
 
-void handle_input(Board *board, Input input)
+void handle_input(Input input)
 {
-    Cell *cell_under_mouse = NULL;
+    Engine *engine = NULL; // the board under the mouse
+    u32 board_idx = 0;
+    bool cell_is_under_mouse = false;
+    u32 mouse_cell_col = 0;
+    u32 mouse_cell_row = 0;
     bool face_is_under_mouse = false;
     Vec2f face_pos = face_pos_px();
     Vec2f cells_offset = cells_offset_px();
+    Vec2f view_dims = view_dims_px();
+    Vec2f mouse = vec2f((f32)input.mouse_x, (f32)input.mouse_y);
     Input last_input = game_state.last_input;
+    Camera *camera = &game_state.camera;
 
 #ifdef DEBUG
     if (!input.debug_key && last_input.debug_key) {
@@ -138,18 +112,26 @@ void handle_input(Board *board, Input input)
     }
 #endif
 
-    // convert window pixel coords to game pixel coords determined by scaling power
-    input.mouse_x <<= game_state.window_scale;
-    input.mouse_y <<= game_state.window_scale;
-
-    i64 mouse_x_off = (i64)input.mouse_x - (i64)cells_offset.x;
-    i64 mouse_y_off = (i64)input.mouse_y - (i64)cells_offset.y;
-    if (mouse_x_off >= 0 && mouse_y_off >= 0) {
-        i64 mouse_cell_col = mouse_x_off / CELL_PIXEL_WIDTH;
-        i64 mouse_cell_row = mouse_y_off / CELL_PIXEL_HEIGHT;
-        // already checked not negative above
-        if (mouse_cell_col < board->width && mouse_cell_row < board->height) {
-            cell_under_mouse = board_pos_to_cell(board, mouse_cell_col, mouse_cell_row);
+    /* Camera: drag with the middle button, zoom with the wheel */
+    if (input.mouse_middle_down && last_input.mouse_middle_down) {
+        camera->pos.x += ((f32)last_input.mouse_x - mouse.x) / camera->zoom;
+        camera->pos.y += ((f32)last_input.mouse_y - mouse.y) / camera->zoom;
+        camera_clamp(camera);
+    }
+    bool mouse_in_view = mouse.x >= cells_offset.x && mouse.x < cells_offset.x + view_dims.x &&
+                         mouse.y >= cells_offset.y && mouse.y < cells_offset.y + view_dims.y;
+    if (input.zoom != 0 && mouse_in_view) {
+        camera_zoom_at(camera, mouse, input.zoom > 0 ? CAMERA_ZOOM_STEP : 1.0F / CAMERA_ZOOM_STEP);
+    }
+
+    if (mouse_in_view) {
+        Vec2f pos = camera_to_play_area_px(mouse);
+        i64 col = (i64)floorf(pos.x / CELL_PIXEL_WIDTH);
+        i64 row = (i64)floorf(pos.y / CELL_PIXEL_HEIGHT);
+        if (play_area_to_board(col, row, &board_idx, &mouse_cell_col, &mouse_cell_row)) {
+            engine = game_engine(board_idx);
+            // the board can't be played while a no-guess one is generating
+            cell_is_under_mouse = !game_state.generating;
         }
     } else if (input.mouse_x >= face_pos.x && input.mouse_x < face_pos.x + FACE_PIXEL_WIDTH &&
                input.mouse_y >= face_pos.y && input.mouse_y < face_pos.y + FACE_PIXEL_HEIGHT
@@ -167,14 +149,25 @@ void handle_input(Board *board, Input input)
         mouse_state = MOUSE_RIGHT_RELEASED;
     }
 
+    /* Undo/redo, on key press; of the board under the mouse if there's more than one */
+    Engine *undo_engine = game_state.boards_across ? engine : game_engine(0);
+    bool can_undo = undo_engine && !game_state.generating;
+    bool undone = false;
+    if (input.undo_key && !last_input.undo_key && can_undo) {
+        undone = engine_undo(undo_engine);
+    } else if (input.redo_key && !last_input.redo_key && can_undo) {
+        undone = engine_redo(undo_engine);
+    }
+    if (undone) {
+        game_state.face_state = face_for_boards();
+    }
+
     /* Mouse click/drag, and release */
     switch (mouse_state) {
         case MOUSE_LEFT_DOWN:
         {
-            if (cell_under_mouse && game_state.playing) {
-                if (cell_under_mouse && cell_under_mouse->state == CELL_UNEXPLORED) {
-                    cell_under_mouse->state = CELL_CLICKED;
-                    board->cell_last_clicked = cell_under_mouse;
+            if (cell_is_under_mouse && engine->status == ENGINE_PLAYING) {
+                if (engine_press(engine, mouse_cell_col, mouse_cell_row)) {
                     game_state.face_state = FACE_SCARED;
                 }
                 break;
@@ -186,17 +179,19 @@ void handle_input(Board *board, Input input)
         }
         case MOUSE_LEFT_RELEASED:
         {
-            if (cell_under_mouse && game_state.playing) {
-                if (cell_under_mouse->state == CELL_UNEXPLORED) {
-                    explore(board, cell_under_mouse);
-                    // start timer
-                    if (game_state.time_started_ms == UINT64_MAX) {
-                        game_state.time_started_ms = SDL_GetTicks64();
-                        game_state.time_ms = game_state.time_started_ms;
-                    }
+            if (cell_is_under_mouse && engine->status == ENGINE_PLAYING) {
+                engine_reveal(engine, mouse_cell_col, mouse_cell_row, input.time_ms);
+                if (engine->status != ENGINE_PLAYING) {
+                    game_state.face_state = face_for_boards();
                 }
                 break;
             }
+            // with more than one, a finished board is dealt again on its own
+            if (cell_is_under_mouse && game_state.boards_across) {
+                game_board_deal(board_idx);
+                game_state.face_state = face_for_boards();
+                break;
+            }
             if (face_is_under_mouse) {
                 game_needs_restart = true;
             }
@@ -204,16 +199,8 @@ void handle_input(Board *board, Input input)
         }
         case MOUSE_RIGHT_RELEASED:
         {
-            if (!cell_under_mouse || !game_state.playing) {
-                break;
-            } else if (cell_under_mouse->state == CELL_UNEXPLORED) {
-                cell_under_mouse->state = CELL_FLAGGED;
-                ASSERT(board->bombs_left > INT64_MIN);
-                board->bombs_left--;
-            } else if (cell_under_mouse->state == CELL_FLAGGED) {
-                cell_under_mouse->state = CELL_UNEXPLORED;
-                ASSERT(board->bombs_left < INT64_MAX);
-                board->bombs_left++;
+            if (cell_is_under_mouse) {
+                engine_toggle_flag(engine, mouse_cell_col, mouse_cell_row);
             }
             break;
         }
@@ -222,24 +209,277 @@ void handle_input(Board *board, Input input)
     }
 }
 
-bool game_update_and_render(Input input)
+static void record_event(ReplayEvent *event)
 {
-    Board *board = &game_state.board;
+    // only input moves the clock on; anything else happens at the last input's time
+    event->time_ms = game_state.replay.time_ms;
+    replay_write(&game_state.replay, event);
+}
+
+// input in game pixels; recorded relative to the bottom of the menu bar so it doesn't depend on the font
+static void record_input(Input input)
+{
+    Replay *replay = &game_state.replay;
+    u32 menu_bar_y = (u32)menu_bar_y_offset_px();
+    ReplayEvent event = {0};
+    event.type = REPLAY_EVENT_INPUT;
+    event.time_ms = MAX(input.time_ms, replay->time_ms);
+    event.mouse_x = input.mouse_x;
+    event.mouse_y = input.mouse_y > menu_bar_y ? input.mouse_y - menu_bar_y : 0;
+    event.buttons = (input.mouse_left_down ? REPLAY_BUTTON_LEFT : 0) |
+                    (input.mouse_right_down ? REPLAY_BUTTON_RIGHT : 0) |
+                    (input.undo_key ? REPLAY_BUTTON_UNDO : 0) |
+                    (input.redo_key ? REPLAY_BUTTON_REDO : 0);
+    // unchanged input does nothing, so there's no need to record it
+    if (event.mouse_x == replay->mouse_x && event.mouse_y == replay->mouse_y &&
+        event.buttons == replay->buttons) {
+        return;
+    }
+    replay_write(replay, &event);
+}
+
+// the camera as input left it, if that's changed
+static void record_camera()
+{
+    Camera *camera = &game_state.camera;
+    Camera *recorded = &game_state.replay_camera;
+    if (camera->pos.x == recorded->pos.x && camera->pos.y == recorded->pos.y &&
+        camera->zoom == recorded->zoom) {
+        return;
+    }
+    ReplayEvent event = {0};
+    event.type = REPLAY_EVENT_CAMERA;
+    event.camera_x = camera->pos.x;
+    event.camera_y = camera->pos.y;
+    event.camera_zoom = camera->zoom;
+    record_event(&event);
+    *recorded = *camera;
+}
+
+// input as it was just after event, given the input before it
+static Input input_after_event(Input input, const InputEvent *event)
+{
+    // a wheel notch is only acted on once
+    input.zoom = 0;
+    switch (event->button) {
+        case INPUT_BUTTON_LEFT:
+        case INPUT_BUTTON_RIGHT:
+        {
+            input.mouse_x = event->mouse_x << game_state.window_scale;
+            input.mouse_y = event->mouse_y << game_state.window_scale;
+            if (event->button == INPUT_BUTTON_LEFT) {
+                input.mouse_left_down = event->down;
+            } else {
+                input.mouse_right_down = event->down;
+            }
+            break;
+        }
+        case INPUT_BUTTON_UNDO:
+            input.undo_key = event->down;
+            break;
+        case INPUT_BUTTON_REDO:
+            input.redo_key = event->down;
+            break;
+        case INPUT_BUTTON_ZOOM_IN:
+        case INPUT_BUTTON_ZOOM_OUT:
+            input.mouse_x = event->mouse_x << game_state.window_scale;
+            input.mouse_y = event->mouse_y << game_state.window_scale;
+            input.zoom = event->button == INPUT_BUTTON_ZOOM_IN ? 1 : -1;
+            break;
+    }
+    return input;
+}
+
+// act on one input state, against the one before it
+static void apply_input(Input input)
+{
+    // reset clicked cell to treat it as unexplored
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        engine_release_press(game_engine(i));
+    }
+    if (game_state.replay_mode == REPLAY_MODE_RECORD) {
+        record_input(input);
+    }
+    handle_input(input);
+    if (game_state.replay_mode == REPLAY_MODE_RECORD) {
+        record_camera();
+    }
+    game_state.last_input = input;
+}
 
+/*
+ * Play the replay's events up to the next input, which is this tick's
+ * In real time, events that haven't happened yet wait for a later tick,
+ * and the last input is used again in the meantime
+ * The replay runs on game time (input->time_ms), so it plays back the
+ * same however the frames fall
+ * Returns false once the replay is over
+ */
+static bool replay_next_input(Input *input)
+{
+    Replay *replay = &game_state.replay;
+    ReplayEvent event;
+    u64 now_ms = UINT64_MAX;
+
+    if (!game_state.replay_fast) {
+        if (!game_state.replay_clock_started) {
+            CHECK(replay_peek(replay, &event), false);
+            game_state.replay_clock_offset_ms = (i64)event.time_ms - (i64)input->time_ms;
+            game_state.replay_clock_started = true;
+        }
+        now_ms = (u64)((i64)input->time_ms + game_state.replay_clock_offset_ms);
+    }
+
+    while (replay_peek(replay, &event)) {
+        if (event.time_ms > now_ms) {
+            *input = game_state.replay_input;
+            // keep the timer running
+            input->time_ms = MAX(now_ms, input->time_ms);
+            return true;
+        }
+        replay_read(replay, &event);
+        switch (event.type) {
+            case REPLAY_EVENT_INPUT:
+            {
+                Input replayed = {0};
+                replayed.time_ms = event.time_ms;
+                replayed.mouse_x = event.mouse_x;
+                replayed.mouse_y = event.mouse_y;
+                replayed.mouse_left_down = event.buttons & REPLAY_BUTTON_LEFT;
+                replayed.mouse_right_down = event.buttons & REPLAY_BUTTON_RIGHT;
+                replayed.undo_key = event.buttons & REPLAY_BUTTON_UNDO;
+                replayed.redo_key = event.buttons & REPLAY_BUTTON_REDO;
+                game_state.replay_input = replayed;
+                *input = replayed;
+                return true;
+            }
+            case REPLAY_EVENT_GAME_START:
+            {
+                game_state.no_guess = event.no_guess;
+                CHECK_LOG(game_start(event.params), false, "Failed to start replayed game");
+                // like in the recording, the params the menu shows don't pin a seed
+                game_state.params.seed = 0;
+                break;
+            }
+            case REPLAY_EVENT_BOARD:
+            {
+                if (game_state.generating) {
+                    no_guess_use_board(event.seed);
+                }
+                break;
+            }
+            case REPLAY_EVENT_CAMERA:
+            {
+                game_state.camera.pos = vec2f(event.camera_x, event.camera_y);
+                game_state.camera.zoom = event.camera_zoom;
+                camera_clamp(&game_state.camera);
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool game_update(Input input)
+{
+    mem_ctx_t mem_ctx = mem_set_context(MEM_CTX_SCRATCH);
+
+    // replayed games start here, before scope 1 is opened
+    if (game_state.replay_mode == REPLAY_MODE_PLAY && !replay_next_input(&input)) {
+        log_info("Replay finished");
+        mem_set_context(mem_ctx);
+        return false;
+    }
+
+    CHECK_LOG(mem_scratch_scope_begin() == 1, true, "unexpected mem scratch scope");
+
+    InputQueue *queue = &game_state.input_queue;
+    if (game_state.replay_mode == REPLAY_MODE_PLAY) {
+        input.mouse_y += (u32)menu_bar_y_offset_px();
+        // the replay's input stands in for the player's
+        queue->head = queue->tail;
+    } else {
+        // convert window pixel coords to game pixel coords determined by scaling power
+        input.mouse_x <<= game_state.window_scale;
+        input.mouse_y <<= game_state.window_scale;
+    }
+
+    bool playing = false;
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        Engine *engine = game_engine(i);
+        if (engine->status == ENGINE_PLAYING) {
+            engine_tick(engine, input.time_ms);
+            playing = true;
+        }
+    }
+    if (playing) {
+        // Switch FACE_SCARED back to smile by default
+        game_state.face_state = FACE_SMILE;
+    }
+    game_state.face_clicked = false;
+
+    if (game_state.generating && noguess_done(&game_state.no_guess_gen)) {
+        no_guess_start_board();
+    }
+
+    // everything that happened since the last tick, in order, then where the mouse is now
+    InputEvent event;
+    while (input_queue_pop(queue, &event)) {
+        Input step = input_after_event(game_state.last_input, &event);
+        step.time_ms = input.time_ms;
+        if (input.real_time_ms >= event.time_ms) {
+            u64 latency_ms = input.real_time_ms - event.time_ms;
+            game_state.input_latency_sum_ms += latency_ms;
+            game_state.input_latency_max_ms = MAX(game_state.input_latency_max_ms, latency_ms);
+            game_state.num_input_events++;
+        }
+        apply_input(step);
+    }
+    apply_input(input);
+
+    CHECK_LOG(mem_scratch_scope_end() == 0, true, "unexpected mem scratch scope");
+
+    if (game_state.save_requested) {
+        game_save(GAME_SAVE_PATH);
+    }
+    // replays restart when the recording did, not when the face or menu is clicked
+    if (game_state.load_requested && game_state.replay_mode == REPLAY_MODE_NONE) {
+        game_load(GAME_SAVE_PATH);
+    } else if (game_needs_restart && game_state.replay_mode != REPLAY_MODE_PLAY) {
+        game_start(game_state.params);
+    }
+    game_needs_restart = false;
+    game_state.save_requested = false;
+    game_state.load_requested = false;
+
+    mem_ctx = mem_set_context(mem_ctx);
+    ASSERT(mem_ctx == MEM_CTX_SCRATCH);
+
+    return true;
+}
+
+void game_render()
+{
 /*
  * We draw the menu bar at the start of the frame because
  * resize_window_to_game depends on getting its height
  * (we could also hardcode the height, see start_game())
+ * What's picked in the menus is acted on by the next update
  */
 #ifdef DEBUG
     if (show_debug) {
         gui_debug();
     }
 #endif
-    game_needs_restart = gui_difficulty(&game_state.params);
+    if (gui_difficulty(&game_state.params)) {
+        game_needs_restart = true;
+    }
 
     mem_ctx_t mem_ctx = mem_set_context(MEM_CTX_SCRATCH);
-    CHECK_LOG(mem_scratch_scope_begin() == 1, true, "unexpected mem scratch scope");
+    if (mem_scratch_scope_begin() != 1) {
+        log_error("unexpected mem scratch scope");
+    }
 
     // TODO maybe have special calibration function to do all this
     // janky resizing stuff that needs to happen after some stuff
@@ -253,153 +493,379 @@ bool game_update_and_render(Input input)
         game_state.window_needs_resize = false;
     }
 
-    // reset clicked cell to treat it as unexplored
-    if (board->cell_last_clicked->state == CELL_CLICKED) {
-        board->cell_last_clicked->state = CELL_UNEXPLORED;
+    draw_game();
+    // everything watching the boards has seen the changes since the last frame
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        engine_clear_changes(game_engine(i));
+    }
+    game_state.drawn = true;
+    game_state.drawn_face_state = game_state.face_state;
+    game_state.drawn_face_clicked = game_state.face_clicked;
+    game_state.drawn_timer = game_timer_shown();
+    game_state.drawn_camera = game_state.camera;
+
+    if (mem_scratch_scope_end() != 0) {
+        log_error("unexpected mem scratch scope");
     }
+    mem_set_context(mem_ctx);
+}
 
-    if (game_state.playing) {
-        if (game_state.time_started_ms != UINT64_MAX) {
-            game_state.time_ms = SDL_GetTicks64();
+bool game_needs_render()
+{
+    Camera *camera = &game_state.camera;
+    Camera *drawn_camera = &game_state.drawn_camera;
+    // the bomb counter only changes with a flag, which is a cell change too
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        ChangeList *changes = &game_engine(i)->board.changes;
+        if (changes->num > 0 || changes->all) {
+            return true;
         }
-        // Switch FACE_SCARED back to smile by default
-        game_state.face_state = FACE_SMILE;
     }
-    game_state.face_clicked = false;
+    return !game_state.drawn || game_state.window_needs_resize ||
+           game_state.face_state != game_state.drawn_face_state ||
+           game_state.face_clicked != game_state.drawn_face_clicked ||
+           game_timer_shown() != game_state.drawn_timer ||
+           camera->pos.x != drawn_camera->pos.x || camera->pos.y != drawn_camera->pos.y ||
+           camera->zoom != drawn_camera->zoom;
+}
 
-    handle_input(board, input);
+u32 game_idle_wait_ms()
+{
+    // the generator finishing isn't an event, so keep checking on it
+    if (game_state.generating) {
+        return GAME_IDLE_POLL_MS;
+    }
+    u32 wait_ms = GAME_IDLE_MAX_WAIT_MS;
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        Engine *engine = game_engine(i);
+        if (engine->status == ENGINE_PLAYING && engine->time_ms != ENGINE_TIME_NONE) {
+            // until the timer counter's next second
+            u64 elapsed_ms = engine->time_ms - engine->time_started_ms;
+            wait_ms = (u32)MIN(1000 - elapsed_ms % 1000, wait_ms);
+        }
+    }
+    return wait_ms;
+}
 
-    draw_game();
-    game_state.last_input = input;
+/*
+ * Start generating a no-guess board for params in the background
+ * The opening click is always the middle of the board
+ * If the generator can't run, the regular board from params is played instead
+ */
+static void no_guess_generate(GameParams params)
+{
+    u32 num_workers = game_state.jobs.num_workers;
+    u64 gen_mem_sz = noguess_mem_size(params.width, params.height, num_workers);
+    void *gen_mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(gen_mem_sz, PAGE_SIZE));
+    if (!gen_mem) {
+        log_error("Failed to alloc no-guess generator memory");
+        return;
+    }
+    ASSERT(params.seed != 0);
+    if (!noguess_start(&game_state.no_guess_gen, &game_state.jobs, params,
+                       params.width / 2, params.height / 2,
+                       GAME_NO_GUESS_MAX_CANDIDATES, num_workers, gen_mem, gen_mem_sz)) {
+        log_error("Failed to start no-guess generator");
+        return;
+    }
+    game_state.generating = true;
+}
 
-    CHECK_LOG(mem_scratch_scope_end() == 0, true, "unexpected mem scratch scope");
+static void no_guess_start_board()
+{
+    u64 seed;
+    if (!noguess_finish(&game_state.no_guess_gen, &seed)) {
+        seed = 0;
+    }
+    no_guess_use_board(seed);
+}
 
-    if (game_needs_restart) {
-        game_needs_restart = false;
-        game_start(game_state.params);
+// swap in the generated board (0 if none was found), and make the opening click for the player
+static void no_guess_use_board(u64 seed)
+{
+    Engine *engine = &game_state.engine;
+    GameParams params = engine->params;
+
+    game_state.generating = false;
+    if (game_state.replay_mode == REPLAY_MODE_RECORD) {
+        ReplayEvent event = {0};
+        event.type = REPLAY_EVENT_BOARD;
+        event.seed = seed;
+        record_event(&event);
+    }
+    if (seed == 0) {
+        log_error("No no-guess board found, playing a regular one");
+        return;
+    }
+    params.seed = seed;
+    if (!engine_new_game(engine, params, game_state.engine_mem, game_state.engine_mem_size)) {
+        log_error("Failed to start no-guess board");
+        return;
     }
+    engine_reveal(engine, params.width / 2, params.height / 2, 0);
+    // the player didn't make the opening, so they can't undo it
+    engine_undo_clear(engine);
+    // the timer waits for the player's first click, not ours
+    engine->time_started_ms = ENGINE_TIME_NONE;
+    engine->time_ms = ENGINE_TIME_NONE;
+    log_info("New no-guess %ux%u game, %u bombs, seed %" PRIu64,
+             params.width, params.height, params.num_bombs, seed);
+}
 
-    mem_ctx = mem_set_context(mem_ctx);
-    ASSERT(mem_ctx == MEM_CTX_SCRATCH);
+// end the current game, freeing everything in scratch scope 0
+static bool game_end()
+{
+    ASSERT(mem_get_current_context() == MEM_CTX_SCRATCH);
+
+    draw_end_game();
+    // the generator's workers use memory from scope 0, so stop them first
+    if (game_state.generating) {
+        noguess_cancel(&game_state.no_guess_gen);
+        noguess_finish(&game_state.no_guess_gen, NULL);
+        game_state.generating = false;
+    }
+    // a loaded board's cells live in its mapped save
+    if (game_state.snapshot_mem) {
+        platform_unmap_file(game_state.snapshot_mem, game_state.snapshot_mem_size);
+        game_state.snapshot_mem = NULL;
+        game_state.snapshot_mem_size = 0;
+    }
+    // multi-board arenas go with scope 0
+    game_state.boards_across = 0;
+    game_state.boards = NULL;
+    // end all the scopes
+    CHECK_LOG(mem_scratch_scope_end() == -1, false, "unexpected mem scratch scope");
+    CHECK_LOG(mem_scratch_scope_begin() == 0, false, "unexpected mem scratch scope");
 
     return true;
 }
 
-static bool board_init(Board *board, u32 width, u32 height, u32 num_bombs)
+// board memory lives in scratch scope 0 until the next game_end
+static void *alloc_engine_mem(u32 width, u32 height)
 {
-    ASSERT(board);
-    ASSERT((u64)width * (u64)height < UINT32_MAX);;
-
-    u32 num_cells = width * height;
-    board->width = width;
-    board->height = height;
-    board->bombs_left = (i64)num_bombs;
-    board->num_bombs = num_bombs;
-    board->num_cells = num_cells;
-    // TODO calloc
-    board->cells = mem_alloc(num_cells * sizeof(Cell));
-    if (!board->cells) {
-        log_error("Failed to allocate board");
-        return false;
+    u64 engine_mem_sz = engine_mem_size(width, height);
+    void *engine_mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(engine_mem_sz, PAGE_SIZE));
+    if (!engine_mem) {
+        log_error("Failed to alloc board memory");
+        return NULL;
     }
-    memset(board->cells, 0, num_cells * sizeof(Cell));
-    board->cell_last_clicked = board->cells;
-    board->bomb_clicked = NULL;
-
-    /* place bombs */
-    i32 bombs_left = num_bombs;
-    ASSERT((u32)bombs_left < num_cells);
-
-    i64 max_iters = 1 << 20;
-    i64 iters = max_iters;
+    game_state.engine_mem = engine_mem;
+    game_state.engine_mem_size = engine_mem_sz;
+    return engine_mem;
+}
 
-    // to generate random numbers we'll mask out the unneeded bits from a call to rand()
-    u32 mask = (1 << (32 - ((u32)CLZ_U64(num_cells) - 32))) - 1;
-    ASSERT(num_cells < RAND_MAX); // otherwise we can't use this method...
-    log_debug("num_cells 0x%x", num_cells);
-    log_debug("mask 0x%x", mask);
+// each move needs up to a board's worth of deltas
+static u32 undo_max_deltas(u64 num_cells)
+{
+    return (u32)MIN(2 * num_cells, GAME_UNDO_MAX_DELTAS);
+}
 
-    while (bombs_left > 0 && iters > 0) {
-        u32 rand_bits = num_cells;
-        while (rand_bits >= num_cells) {
-            u32 rand_num = (u32)rand();
-            rand_bits = rand_num & mask;
-        }
-        // now we have random bits which represent a number less than num_cells
-        u32 idx = rand_bits;
-        Cell *cell = &board->cells[idx];
-        iters--;
-        if (cell->is_bomb) {
-            continue;
-        }
-        /* place bomb and numbers */
-        cell->is_bomb = true;
-        bombs_left--;
-        i64 bomb_c, bomb_r;
-        board_idx_to_pos(board, idx, &bomb_c, &bomb_r);
-        for (i64 r = bomb_r - 1; r <= bomb_r + 1; ++r) {
-            if (r < 0 || r >= board->height) {
-                continue;
-            }
-            for (i64 c = bomb_c - 1; c <= bomb_c + 1; ++c) {
-                if (c < 0 || c >= board->width) {
-                    continue;
-                }
-                Cell *neighbor = board_pos_to_cell(board, c, r);
-                if (neighbor->is_bomb) {
-                    // reset this so bombs next to each other all get 0 for bombs_around
-                    neighbor->bombs_around = 0;
-                    continue;
-                }
-                neighbor->bombs_around++;
-            }
+// everything else a game needs once its boards are dealt, new or loaded
+static bool game_board_ready()
+{
+    // multi-board mode's boards have undo logs in their arenas
+    if (!game_state.boards_across) {
+        Engine *engine = &game_state.engine;
+        u32 max_deltas = undo_max_deltas(engine->board.num_cells);
+        u64 undo_mem_sz = engine_undo_mem_size(max_deltas);
+        void *undo_mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(undo_mem_sz, PAGE_SIZE));
+        if (!undo_mem || !engine_undo_init(engine, max_deltas, undo_mem, undo_mem_sz)) {
+            // still playable, just without undo
+            log_error("Failed to set up undo");
         }
     }
-    log_debug("Used %ld iters", max_iters - iters);
+    game_state.face_state = FACE_SMILE;
+    // top left of the board, at 1:1
+    game_state.camera.pos = vec2f(0, 0);
+    game_state.camera.zoom = 1.0F;
+    game_state.window_needs_resize = true;
+    // Reset the scale to something really wrong... should be visible if there's a problem
+    game_state.window_scale = 99999;
+    // We make a guess here, but the rendering loop is arranged so we don't really have to
+    game_state.main_menu_bar_height_window_px = 19;
 
-    if (iters <= 0) {
-        log_error("Failed to place bombs - RNG is broken!");
+    if (!draw_start_game()) {
+        log_error("Failed to init draw state for board");
         return false;
     }
 
     return true;
 }
 
-static bool game_start(GameParams params)
+// a board's engine memory and undo log, each page aligned
+static u64 game_board_arena_size(GameParams params)
 {
-    ASSERT(mem_get_current_context() == MEM_CTX_SCRATCH);
-    Board *board = &game_state.board;
+    u64 num_cells = (u64)params.width * params.height;
+    return ALIGN_UP_POW_2(engine_mem_size(params.width, params.height), PAGE_SIZE) +
+           ALIGN_UP_POW_2(engine_undo_mem_size(undo_max_deltas(num_cells)), PAGE_SIZE);
+}
 
-    /*
-     * We both end the current game and start a new one here
-     * TODO if this gets more complicated, should probably
-     * have a game_end() function
-     */
-    draw_end_game(board);
-    // end all the scopes
+// tear multi-board mode's board i down and deal a new one in its arena; no other board is touched
+static bool game_board_deal(u32 i)
+{
+    ASSERT(i < game_num_boards());
+    GameBoard *board = &game_state.boards[i];
+    Engine *engine = &board->engine;
+    GameParams params = game_state.params;
+    // every board picks its own seed
+    params.seed = 0;
+
+    bump_reset(&board->arena);
+    u64 engine_mem_sz = engine_mem_size(params.width, params.height);
+    void *engine_mem = bump_alloc(&board->arena, ALIGN_UP_POW_2(engine_mem_sz, PAGE_SIZE));
+    CHECK_LOG(engine_mem, false, "Board %u arena too small", i);
+    CHECK_LOG(engine_new_game(engine, params, engine_mem, engine_mem_sz), false,
+              "Failed to start board %u", i);
+
+    u32 max_deltas = undo_max_deltas(engine->board.num_cells);
+    u64 undo_mem_sz = engine_undo_mem_size(max_deltas);
+    void *undo_mem = bump_alloc(&board->arena, ALIGN_UP_POW_2(undo_mem_sz, PAGE_SIZE));
+    if (!undo_mem || !engine_undo_init(engine, max_deltas, undo_mem, undo_mem_sz)) {
+        log_error("Failed to set up undo for board %u", i);
+    }
+    return true;
+}
 
-    CHECK_LOG(mem_scratch_scope_end() == -1, false, "unexpected mem scratch scope");
-    CHECK_LOG(mem_scratch_scope_begin() == 0, false, "unexpected mem scratch scope");
+/*
+ * Deal across * across boards of params, each with its own arena; the
+ * arenas are carved out of scratch scope 0, so they all go at game_end()
+ * Replays and the no-guess generator only deal with single boards, so
+ * neither applies here
+ */
+static bool game_start_multi(GameParams params, u32 across)
+{
+    u32 num_boards = across * across;
+
+    CHECK(game_end(), false);
+
+    u64 arena_size = game_board_arena_size(params);
+    GameBoard *boards = mem_alloc(num_boards * sizeof(GameBoard));
+    u8 *arenas_mem = mem_alloc_aligned(PAGE_SIZE, num_boards * arena_size);
+    CHECK_LOG(boards && arenas_mem, false, "Failed to alloc %ux%u boards", across, across);
+
+    // seeded from the one engine's stream, so a pinned seed deals the same grid
+    Rng seed_rng;
+    rng_seed(&seed_rng, params.seed ? params.seed : rng_next(&game_state.engine.seed_rng));
+    game_state.params = params;
+    game_state.boards = boards;
+    game_state.boards_across = across;
+    for (u32 i = 0; i < num_boards; ++i) {
+        GameBoard *board = &boards[i];
+        engine_init(&board->engine, rng_next(&seed_rng), game_state.engine.flags);
+        bump_init_allocator(&board->arena, arenas_mem + i * arena_size, arena_size);
+        CHECK(game_board_deal(i), false);
+    }
+
+    CHECK(game_board_ready(), false);
+    log_info("New %ux%u grid of %ux%u games, %u bombs each",
+             across, across, params.width, params.height, params.num_bombs);
+
+    return true;
+}
+
+static bool game_start(GameParams params)
+{
+    Engine *engine = &game_state.engine;
+
+    u32 across = game_state.replay_mode == REPLAY_MODE_NONE ? game_state.multi_across : 1;
+    if (across > 1 && (u64)params.width * params.height * across * across > PARAMS_MAX_CELLS) {
+        log_error("Too many cells for %ux%u boards, playing just the one", across, across);
+        game_state.multi_across = 1;
+    } else if (across > 1) {
+        return game_start_multi(params, across);
+    }
 
-    if (!board_init(board, params.width, params.height, params.num_bombs)) {
-        log_error("Failed to init board");
+    CHECK(game_end(), false);
+
+    void *engine_mem = alloc_engine_mem(params.width, params.height);
+    CHECK(engine_mem, false);
+    if (!engine_new_game(engine, params, engine_mem, game_state.engine_mem_size)) {
+        log_error("Failed to start engine game");
         return false;
     }
-    game_state.time_started_ms = UINT64_MAX;
-    game_state.time_ms = UINT64_MAX;
-    game_state.face_state = FACE_SMILE;
-    game_state.playing = true;
-    game_state.window_needs_resize = true;
-    // Reset the scale to something really wrong... should be visible if there's a problem
-    game_state.window_scale = 99999;
+    if (game_state.replay_mode == REPLAY_MODE_RECORD) {
+        ReplayEvent event = {0};
+        event.type = REPLAY_EVENT_GAME_START;
+        event.params = engine->params;
+        event.no_guess = game_state.no_guess;
+        record_event(&event);
+    }
     game_state.params = params;
-    // We make a guess here, but the rendering loop is arranged so we don't really have to
-    game_state.main_menu_bar_height_window_px = 19;
 
-    if (!draw_start_game(board)) {
-        log_error("Failed to init draw state for board");
+    CHECK(game_board_ready(), false);
+    if (game_state.no_guess && game_state.replay_mode == REPLAY_MODE_PLAY) {
+        // the replay has the board the generator found
+        game_state.generating = true;
+    } else if (game_state.no_guess) {
+        // this board stands in (unplayable) until the generator finds one
+        no_guess_generate(engine->params);
+    } else {
+        log_info("New %ux%u game, %u bombs, seed %" PRIu64,
+                 params.width, params.height, params.num_bombs, engine->params.seed);
+    }
+
+    return true;
+}
+
+// write the board out in one go; see EngineSnapshot
+static bool game_save(const char *path)
+{
+    Engine *engine = &game_state.engine;
+    CHECK_LOG(!game_state.generating, false, "Can't save while generating a board");
+    CHECK_LOG(!game_state.boards_across, false, "Can't save more than one board");
+
+    u64 size;
+    EngineSnapshot *snapshot = engine_snapshot(engine, game_state.last_input.time_ms, &size);
+    CHECK_LOG(file_write(path, snapshot, size), false, "Failed to save game to \"%s\"", path);
+    log_info("Saved game to \"%s\", %" PRIu64 " bytes", path, size);
+    return true;
+}
+
+/*
+ * Map a saved game and play on from it
+ * The cells and bitplanes are used straight from the mapping, not copied;
+ * checking the file reads the bitplanes and the border, and the rest of the
+ * cells are only read in as they're touched
+ */
+static bool game_load(const char *path)
+{
+    Engine *engine = &game_state.engine;
+
+    u64 snapshot_size;
+    void *snapshot = platform_map_file(path, &snapshot_size);
+    CHECK_LOG(snapshot, false, "Failed to open saved game \"%s\"", path);
+    // check everything before ending the current game, so a bad file doesn't lose it
+    if (!engine_snapshot_valid(snapshot, snapshot_size)) {
+        platform_unmap_file(snapshot, snapshot_size);
+        return false;
+    }
+    EngineSnapshot *snap = (EngineSnapshot *)snapshot;
+
+    if (!game_end()) {
+        platform_unmap_file(snapshot, snapshot_size);
         return false;
     }
+    game_state.snapshot_mem = snapshot;
+    game_state.snapshot_mem_size = snapshot_size;
+
+    void *engine_mem = alloc_engine_mem(snap->width, snap->height);
+    CHECK(engine_mem, false);
+    if (!engine_load_snapshot(engine, snapshot, snapshot_size, game_state.last_input.time_ms,
+                              engine_mem, game_state.engine_mem_size)) {
+        log_error("Failed to load saved game");
+        return false;
+    }
+    // the face starts a fresh board of the same size
+    game_state.params = engine->params;
+    game_state.params.seed = 0;
+
+    CHECK(game_board_ready(), false);
+    if (engine->status == ENGINE_LOST) {
+        game_state.face_state = FACE_DEAD;
+    } else if (engine->status == ENGINE_WON) {
+        game_state.face_state = FACE_COOL;
+    }
+    log_info("Loaded %ux%u game from \"%s\"", engine->params.width, engine->params.height, path);
 
     return true;
 }
@@ -411,8 +877,21 @@ bool game_init()
         return false;
     }
 
-    // TODO replace c srand() and rand()
-    srand((unsigned int)time(NULL));
+    engine_init(&game_state.engine, (u64)time(NULL), ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+    game_state.idle_render = true;
+    game_state.multi_across = 1;
+
+    // the job system runs for the life of the game, so this is never freed
+    u64 jobs_mem_sz = job_system_mem_size(0, GAME_JOB_DEQUE_CAPACITY);
+    void *jobs_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(jobs_mem_sz, 16));
+    if (!jobs_mem) {
+        log_error("Failed to alloc job system memory");
+        return false;
+    }
+    if (!job_system_start(&game_state.jobs, 0, GAME_JOB_DEQUE_CAPACITY, jobs_mem, jobs_mem_sz)) {
+        log_error("Failed to start job system");
+        return false;
+    }
 
     mem_set_context(MEM_CTX_SCRATCH);
     if (!game_start(game_easy)) {
@@ -430,3 +909,51 @@ bool game_init()
     return true;
 }
 
+
+bool game_replay_record(const char *path)
+{
+    ASSERT(path);
+    ASSERT(game_state.replay_mode == REPLAY_MODE_NONE);
+
+    mem_ctx_t mem_ctx = mem_set_context(MEM_CTX_NOFREE);
+    void *mem = mem_alloc(GAME_REPLAY_MAX_BYTES);
+    mem_set_context(mem_ctx);
+    CHECK_LOG(mem, false, "Failed to alloc replay memory");
+
+    replay_init_writer(&game_state.replay, mem, GAME_REPLAY_MAX_BYTES);
+    game_state.replay_path = path;
+    game_state.replay_mode = REPLAY_MODE_RECORD;
+    log_info("Recording replay to \"%s\"", path);
+    return true;
+}
+
+bool game_replay_play(const char *path, bool fast)
+{
+    ASSERT(path);
+    ASSERT(game_state.replay_mode == REPLAY_MODE_NONE);
+
+    u64 len = 0;
+    mem_ctx_t mem_ctx = mem_set_context(MEM_CTX_NOFREE);
+    char *data = file_read(path, &len, false);
+    mem_set_context(mem_ctx);
+    CHECK_LOG(data, false, "Failed to read replay \"%s\"", path);
+    CHECK(replay_init_reader(&game_state.replay, data, len), false);
+
+    game_state.replay_path = path;
+    game_state.replay_fast = fast;
+    game_state.replay_clock_started = false;
+    game_state.replay_mode = REPLAY_MODE_PLAY;
+    log_info("Playing replay \"%s\"%s", path, fast ? " as fast as possible" : "");
+    return true;
+}
+
+bool game_replay_save()
+{
+    CHECK(game_state.replay_mode == REPLAY_MODE_RECORD, true);
+
+    Replay *replay = &game_state.replay;
+    CHECK_LOG(file_write(game_state.replay_path, replay->data, replay->len), false,
+              "Failed to save replay \"%s\"", game_state.replay_path);
+    log_info("Saved replay \"%s\", %" PRIu64 " bytes", game_state.replay_path, replay->len);
+    return true;
+}
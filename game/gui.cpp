@@ -3,6 +3,7 @@
 #include"game.h"
 #include"log.h"
 #include"mem.h"
+#include"platform.h"
 
 /* 
  * Open ai chat wrote some of the code in this file...
@@ -11,10 +12,16 @@
 
 C_BEGIN
 
-// Global variables for the FPS counter
-static float fps_time = 0.0f;
+/*
+ * Global variables for the FPS and CPU counters
+ * Measured against the clock, since with idle rendering frames don't
+ * come at a steady rate
+ */
+static u64 fps_start_ns = 0;
+static u64 cpu_start_ns = 0;
 static int fps_frames = 0;
 static float last_fps = 0.0f;
+static float last_cpu = 0.0f;
 
 const ImGuiWindowFlags gui_flags = ImGuiWindowFlags_NoDecoration |
                                    ImGuiWindowFlags_NoMove |
@@ -23,13 +30,21 @@ const ImGuiWindowFlags gui_flags = ImGuiWindowFlags_NoDecoration |
 
 void gui_debug()
 {
-    fps_time += ImGui::GetIO().DeltaTime;
+    u64 now_ns = platform_ticks_ns();
+    u64 cpu_ns = platform_cpu_time_ns();
+    if (fps_start_ns == 0) {
+        fps_start_ns = now_ns;
+        cpu_start_ns = cpu_ns;
+    }
     fps_frames++;
+    f32 fps_time = (f32)(now_ns - fps_start_ns) / 1e9f;
     if (fps_time >= 1.0f)
     {
-        // Calculate the FPS and reset the counters
+        // Calculate the FPS and CPU use (of one core), and reset the counters
         last_fps = fps_frames / fps_time;
-        fps_time = 0.0f;
+        last_cpu = 100.0f * (f32)(cpu_ns - cpu_start_ns) / (f32)(now_ns - fps_start_ns);
+        fps_start_ns = now_ns;
+        cpu_start_ns = cpu_ns;
         fps_frames = 0;
     }
 
@@ -42,9 +57,21 @@ void gui_debug()
     //ImGui::SetWindowSize(ImVec2(90, 20), ImGuiCond_Always);
 
     ImGui::Text("FPS: %.1f", last_fps);
+    ImGui::Text("CPU: %.1f%%", last_cpu);
 
     ImGui::Text("Alloc: %lukB", allocated/1000);
 
+    // the first board's, in multi-board mode
+    Engine *engine = game_engine(0);
+    UndoLog *undo = &engine->undo;
+    ImGui::Text("Undo: %u/%u moves", undo->num_moves, undo->end_moves);
+    ImGui::Text("Undo log: %lukB", engine_undo_mem_used(engine)/1000);
+
+    u64 num_events = game_state.num_input_events;
+    ImGui::Text("Input lag: %.1fms", num_events ? (f64)game_state.input_latency_sum_ms / (f64)num_events : 0.0);
+    ImGui::Text("Input lag max: %lums", game_state.input_latency_max_ms);
+    ImGui::Text("Input dropped: %lu", game_state.input_queue.num_dropped);
+
     ImGui::End();
 }
 
@@ -52,6 +79,7 @@ void validate_params(GameParams *params)
 {
     params->width = CLAMP(params->width, PARAMS_MIN_WIDTH, PARAMS_MAX_WIDTH);
     params->height = CLAMP(params->height, PARAMS_MIN_HEIGHT, PARAMS_MAX_HEIGHT);
+    params->height = MIN(params->height, PARAMS_MAX_CELLS / params->width);
     params->num_bombs = CLAMP(params->num_bombs, PARAMS_MIN_BOMBS, PARAMS_MAX_BOMBS);
     params->num_bombs = MIN(params->num_bombs, (params->height * params->width) - 1);
 }
@@ -88,7 +116,7 @@ bool gui_difficulty(GameParams *params)
 
     if (ImGui::BeginPopupModal("CustomPopup", NULL, gui_flags)) {
 
-        ImGui::SetWindowSize(ImVec2(183, 165), ImGuiCond_Always);
+        ImGui::SetWindowSize(ImVec2(183, 213), ImGuiCond_Always);
         ImGui::SetWindowPos(ImVec2(25, 45), ImGuiCond_Always);
         ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(15,10));
         ImGui::PushStyleVar(ImGuiStyleVar_ItemInnerSpacing, ImVec2(8,4));
@@ -105,6 +133,8 @@ bool gui_difficulty(GameParams *params)
         if (ImGui::InputScalar("bombs", ImGuiDataType_U32, &custom_params.num_bombs)) {
             validate_params(&custom_params);
         }
+        // 0 for a random board
+        ImGui::InputScalar("seed", ImGuiDataType_U64, &custom_params.seed);
         if (ImGui::Button("Begin")) {
             validate_params(&custom_params);
             *params = custom_params;
@@ -129,6 +159,21 @@ bool gui_difficulty(GameParams *params)
         ImVec2 window_dims = ImGui::GetWindowSize();
         game_state.main_menu_bar_height_window_px = window_dims.y;//ImGui::GetFrameHeight();
 
+        if (ImGui::BeginMenu("Game"))
+        {
+            bool playable = !game_state.generating && !game_state.boards_across;
+            if (ImGui::MenuItem("Save", NULL, false, playable)) {
+                game_state.save_requested = true;
+            }
+            // a replay couldn't reproduce a board from a file
+            if (ImGui::MenuItem("Load", NULL, false, game_state.replay_mode == REPLAY_MODE_NONE)) {
+                game_state.load_requested = true;
+            }
+            ImGui::Separator();
+            ImGui::MenuItem("Idle rendering", NULL, &game_state.idle_render);
+            ImGui::EndMenu();
+        }
+
         // Create the "Difficulty" menubar menu
         if (ImGui::BeginMenu("Difficulty"))
         {
@@ -148,6 +193,23 @@ bool gui_difficulty(GameParams *params)
             if (ImGui::MenuItem("Custom")) {
                 open_custom_popup = true;
             }
+            ImGui::Separator();
+            // grids of boards can't be replayed
+            static const char *grids[] = {"One board", "2x2 boards", "3x3 boards", "4x4 boards"};
+            static_assert(ARRAY_LEN(grids) == GAME_MULTI_MAX_ACROSS, "a menu item for every grid size");
+            for (u32 i = 0; i < ARRAY_LEN(grids); ++i) {
+                u32 across = i + 1;
+                if (ImGui::MenuItem(grids[i], NULL, game_state.multi_across == across,
+                                    game_state.replay_mode == REPLAY_MODE_NONE)) {
+                    game_state.multi_across = across;
+                    ret = true;
+                }
+            }
+            ImGui::Separator();
+            // restart with the same params either way
+            if (ImGui::MenuItem("No guessing", NULL, &game_state.no_guess)) {
+                ret = true;
+            }
 
             // End the "Difficulty" menubar menu
             ImGui::EndMenu();
@@ -0,0 +1,112 @@
+/*
+ * Just enough atomics to share counters and flags between threads
+ * Everything is sequentially consistent; nothing using these is hot
+ * enough to be worth weaker orderings
+ */
+#pragma once
+#include"types.h"
+
+#ifdef _MSC_VER
+#include<intrin.h>
+#endif
+
+C_BEGIN
+
+static u32 atomic_load_u32(volatile u32 *ptr)
+{
+#ifdef _MSC_VER
+    return (u32)_InterlockedOr((volatile long *)ptr, 0);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void atomic_store_u32(volatile u32 *ptr, u32 val)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange((volatile long *)ptr, (long)val);
+#else
+    __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// returns the value before the add
+static u32 atomic_fetch_add_u32(volatile u32 *ptr, u32 val)
+{
+#ifdef _MSC_VER
+    return (u32)_InterlockedExchangeAdd((volatile long *)ptr, (long)val);
+#else
+    return __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Set *ptr to desired if it's *expected
+ * Otherwise, returns false and puts the value seen in *expected
+ */
+static bool atomic_cas_u32(volatile u32 *ptr, u32 *expected, u32 desired)
+{
+#ifdef _MSC_VER
+    u32 seen = (u32)_InterlockedCompareExchange((volatile long *)ptr, (long)desired, (long)*expected);
+    if (seen == *expected) {
+        return true;
+    }
+    *expected = seen;
+    return false;
+#else
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static u64 atomic_load_u64(volatile u64 *ptr)
+{
+#ifdef _MSC_VER
+    return (u64)_InterlockedOr64((volatile __int64 *)ptr, 0);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void atomic_store_u64(volatile u64 *ptr, u64 val)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange64((volatile __int64 *)ptr, (__int64)val);
+#else
+    __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// returns the value before the add
+static u64 atomic_fetch_add_u64(volatile u64 *ptr, u64 val)
+{
+#ifdef _MSC_VER
+    return (u64)_InterlockedExchangeAdd64((volatile __int64 *)ptr, (__int64)val);
+#else
+    return __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// as atomic_cas_u32()
+static bool atomic_cas_u64(volatile u64 *ptr, u64 *expected, u64 desired)
+{
+#ifdef _MSC_VER
+    u64 seen = (u64)_InterlockedCompareExchange64((volatile __int64 *)ptr, (__int64)desired, (__int64)*expected);
+    if (seen == *expected) {
+        return true;
+    }
+    *expected = seen;
+    return false;
+#else
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// *ptr = MIN(*ptr, val)
+static void atomic_min_u64(volatile u64 *ptr, u64 val)
+{
+    u64 seen = atomic_load_u64(ptr);
+    while (val < seen && !atomic_cas_u64(ptr, &seen, val)) {
+    }
+}
+
+C_END
@@ -0,0 +1,92 @@
+/*
+ * Bitplane board representation
+ * Each plane is one bit per cell, rows packed into 64-bit words
+ * (bit i of word w in a row is column w*64 + i)
+ * Bits past the board width are always 0, so whole-plane popcounts
+ * and masks don't need any edge handling
+ */
+#pragma once
+#include"types.h"
+
+C_BEGIN
+
+#define BITBOARD_WORD_BITS 64
+
+enum {
+    BITPLANE_BOMB = 0,
+    BITPLANE_EXPLORED,
+    BITPLANE_FLAGGED,
+    BITPLANE_NUM_PLANES
+};
+
+typedef struct {
+    u64 *planes[BITPLANE_NUM_PLANES];
+    u32 words_per_row; // ceil(width / 64)
+    u32 width;
+    u32 height;
+} BitBoard;
+
+static u64 bitboard_plane_words(u32 width, u32 height)
+{
+    return ((u64)(width + BITBOARD_WORD_BITS - 1) / BITBOARD_WORD_BITS) * (u64)height;
+}
+
+static u64 *bitboard_word(BitBoard *bits, u32 plane, u32 c, u32 r)
+{
+    ASSERT(bits);
+    ASSERT(plane < BITPLANE_NUM_PLANES);
+    ASSERT(c < bits->width);
+    ASSERT(r < bits->height);
+
+    return &bits->planes[plane][(u64)r * bits->words_per_row + c / BITBOARD_WORD_BITS];
+}
+
+static bool bitboard_get(BitBoard *bits, u32 plane, u32 c, u32 r)
+{
+    return (*bitboard_word(bits, plane, c, r) >> (c % BITBOARD_WORD_BITS)) & 1;
+}
+
+static void bitboard_set(BitBoard *bits, u32 plane, u32 c, u32 r, bool value)
+{
+    u64 *word = bitboard_word(bits, plane, c, r);
+    u64 bit = 1ULL << (c % BITBOARD_WORD_BITS);
+    *word = value ? (*word | bit) : (*word & ~bit);
+}
+
+// bytes needed for all planes of a width * height board
+u64 bitboard_mem_size(u32 width, u32 height);
+/*
+ * Point the planes into mem (bitboard_mem_size() bytes, 8 byte aligned)
+ * and clear them
+ */
+void bitboard_init(BitBoard *bits, u32 width, u32 height, void *mem);
+// same, but keep the planes already in mem, e.g. a snapshot's
+void bitboard_attach(BitBoard *bits, u32 width, u32 height, void *mem);
+
+u64 bitboard_popcount(BitBoard *bits, u32 plane);
+// set bits of plane that are clear in mask_plane
+u64 bitboard_popcount_and_not(BitBoard *bits, u32 plane, u32 mask_plane);
+/*
+ * Whether the bits past the width are all 0, as everything here assumes;
+ * only planes that came from outside (see bitboard_attach()) can break it
+ */
+bool bitboard_padding_clear(BitBoard *bits);
+// number of set bits of plane in the 3x3 square around c, r, including c, r
+u32 bitboard_count_around(BitBoard *bits, u32 plane, u32 c, u32 r);
+/*
+ * Call fn for each cell set in plane and clear in mask_plane
+ * e.g. bombs that aren't flagged
+ */
+void bitboard_for_each_and_not(BitBoard *bits, u32 plane, u32 mask_plane,
+                               void (*fn)(void *data, u32 c, u32 r), void *data);
+/*
+ * Count the bombs around every cell using bit-sliced adders over whole
+ * words; 64 cells per add instead of 1
+ * Writes one count per cell to counts (width * height, row major)
+ * Bombs get a count of 0
+ */
+void bitboard_count_neighbours(BitBoard *bits, u8 *counts);
+// same, for row r only; counts is width bytes
+void bitboard_count_neighbours_row(BitBoard *bits, u32 r, u8 *counts);
+
+C_END
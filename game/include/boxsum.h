@@ -0,0 +1,45 @@
+/*
+ * 3x3 box sum over a byte-per-cell bomb mask, for counting
+ * bombs_around of a whole board at once
+ * Vectorized with SSE2/AVX2 where available, picked at runtime
+ */
+#pragma once
+#include"types.h"
+
+C_BEGIN
+
+enum {
+    BOXSUM_SCALAR = 0,
+    BOXSUM_SSE2,
+    BOXSUM_AVX2,
+    BOXSUM_NUM_KERNELS
+};
+
+/*
+ * The mask has a ring of 0s one cell wide around the board, so the
+ * kernels never need bounds checks
+ * Row stride is width + 2, cell c, r lives at (r + 1) * (width + 2) + c + 1
+ */
+static u64 boxsum_mask_size(u32 width, u32 height)
+{
+    return ((u64)width + 2) * ((u64)height + 2);
+}
+
+static u8 *boxsum_mask_cell(u8 *mask, u32 width, u32 c, u32 r)
+{
+    return &mask[((u64)r + 1) * ((u64)width + 2) + c + 1];
+}
+
+// best kernel this cpu supports
+u32 boxsum_best_kernel();
+const char *boxsum_kernel_name(u32 kernel);
+
+/*
+ * For every cell, write the number of 1s in the 3x3 square around it to
+ * counts (width * height, row major), or 0 if the cell itself is a 1
+ * mask must be padded as above, boxsum_mask_size() bytes
+ * kernel must be supported (<= boxsum_best_kernel())
+ */
+void boxsum_count(u32 kernel, const u8 *mask, u32 width, u32 height, u8 *counts);
+
+C_END
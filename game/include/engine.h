@@ -0,0 +1,391 @@
+/*
+ * Headless board engine
+ * Board rules only - no SDL, GL or global state, so any number of
+ * Engines can run side by side (e.g. one per thread in batch tools)
+ * The game is just one client of this
+ */
+#pragma once
+#include"types.h"
+#include"allocator.h"
+#include"bitboard.h"
+#include"rng.h"
+
+C_BEGIN
+
+typedef struct {
+    u32 width;
+    u32 height;
+    u32 num_bombs;
+    // 0 picks a fresh one; the engine's copy of the params has the seed actually used
+    u64 seed;
+} GameParams;
+
+static const GameParams game_easy = { .width = 9, .height = 9, .num_bombs = 10, .seed = 0 };
+static const GameParams game_medium = { .width = 16, .height = 16, .num_bombs = 40, .seed = 0 };
+static const GameParams game_hard = { .width = 30, .height = 16, .num_bombs = 99, .seed = 0 };
+static const GameParams game_custom_default = { .width = 6, .height = 31, .num_bombs = 42, .seed = 0 };
+
+enum {
+    CELL_UNEXPLORED = 0,
+    CELL_FLAGGED,
+    CELL_CLICKED,
+    CELL_EXPLORED
+};
+
+/*
+ * One byte per cell, so a board costs a predictable num_cells bytes
+ * (plus the border, fill stack and bitplanes, see engine_mem_size())
+ * bombs_around is 0..8 so 4 bits is enough
+ */
+typedef struct {
+    u8 state : 2; // CELL_*
+    u8 bombs_around : 4;
+    u8 is_bomb : 1;
+    u8 is_border : 1; // part of the ring around the board, see Board
+} Cell;
+
+static_assert(sizeof(Cell) == 1, "Cell should pack into a byte");
+
+/*
+ * The ring of cells around every board
+ * Explored, empty and never a bomb, so flood fills stop at it and
+ * neighbour counts of bombs and flags see nothing there
+ */
+static const Cell cell_border = { CELL_EXPLORED, 0, 0, 1 };
+
+// cell indices are u32, so boards can't have more cells than this
+#define ENGINE_MAX_CELLS ((u64)UINT32_MAX)
+// cell index for 'no cell', which ENGINE_MAX_CELLS keeps out of range
+#define BOARD_NO_CELL UINT32_MAX
+
+/*
+ * Undo log deltas are one u32: cell index << 4 | old state << 2 | new state
+ * so boards with undo can't have more cells than this
+ */
+#define ENGINE_UNDO_MAX_CELLS (1ULL << 28)
+#define UNDO_DELTA(idx, old_state, new_state) (((u32)(idx) << 4) | ((u32)(old_state) << 2) | (u32)(new_state))
+#define UNDO_DELTA_IDX(delta) ((delta) >> 4)
+#define UNDO_DELTA_OLD(delta) (((delta) >> 2) & 0x3)
+#define UNDO_DELTA_NEW(delta) ((delta) & 0x3)
+
+typedef struct {
+    u32 first_delta; // deltas run up to the next move's first_delta
+    u8 status; // engine status after the move
+} UndoMove;
+
+/*
+ * Every cell state change made by reveals and flag toggles, grouped into
+ * moves, so undoing or redoing a move only touches the cells it changed
+ * Moves past num_moves (up to end_moves) have been undone and can be
+ * redone, until a new move is made
+ * When the log fills up, the oldest moves are dropped
+ */
+typedef struct {
+    u32 *deltas; // UNDO_DELTA()s
+    UndoMove *moves;
+    u32 max_deltas;
+    u32 max_moves;
+    u32 num_deltas;
+    u32 end_deltas;
+    u32 num_moves;
+    u32 end_moves;
+    bool recording; // moves[num_moves] is the move being recorded
+    bool overflowed; // the move being recorded didn't fit
+} UndoLog;
+
+/*
+ * Fixed layout save of a board, with no pointers, so it can be written
+ * with a single write and loaded by mapping the file
+ * The header is followed by the cells (with their border, as laid out
+ * in Board), then the bitplanes (if any), at the offsets it gives. Every
+ * board keeps this layout at the start of its memory, so there's nothing
+ * to gather up when saving
+ * Fields are native endian and Cell is its in-memory bitfield, so
+ * snapshots move between little endian builds only
+ */
+#define ENGINE_SNAPSHOT_MAGIC 0x50414E53u // "SNAP"
+#define ENGINE_SNAPSHOT_VERSION 2
+// cell index for 'no cell' in snapshots
+#define ENGINE_SNAPSHOT_NO_CELL UINT64_MAX
+
+typedef struct {
+    u32 magic; // ENGINE_SNAPSHOT_MAGIC
+    u32 version; // ENGINE_SNAPSHOT_VERSION
+    u32 header_size; // sizeof(EngineSnapshot)
+    u32 status; // ENGINE_PLAYING etc
+    u32 width;
+    u32 height;
+    u32 num_bombs;
+    u32 bombs_placed;
+    u64 seed;
+    u64 num_cells;
+    u64 cells_offset; // of the border's first cell, from the start of the header
+    u64 bits_offset; // 0 if the board has no bitplanes
+    u64 size; // header, cells and bitplanes
+    i64 bombs_left;
+    u64 num_safe_explored;
+    u64 time_elapsed_ms; // ENGINE_TIME_NONE if the timer hasn't started
+    u64 cell_last_clicked; // cell indices, or ENGINE_SNAPSHOT_NO_CELL
+    u64 bomb_clicked;
+    Rng rng; // so a board saved before the first click places the same bombs
+} EngineSnapshot;
+
+/*
+ * Cells whose state changed since the list was last cleared, so the
+ * renderer and anything else watching the board can just look at those
+ * Cells can appear more than once. When more change than fit (a big
+ * opening) or the board is replaced, all is set instead: treat every
+ * cell as changed
+ */
+#define ENGINE_MAX_CHANGES (1 << 14)
+typedef struct {
+    u32 *idxs; // cell indices
+    u32 num;
+    u32 capacity;
+    bool all;
+} ChangeList;
+
+typedef struct {
+    EngineSnapshot *snapshot; // header of the board's snapshot layout, see engine_snapshot()
+    /*
+     * The cells sit inside a one cell border (see cell_border), so every
+     * real cell has 8 neighbours in memory and neighbour visits are just
+     * cell + neighbours[i], with no bounds checks
+     * cells points at cell 0, 0, and row r starts at cells + r * stride
+     * Cell indices (undo, bitplanes, solvers...) are still r * width + c;
+     * see board_idx_to_cell()
+     */
+    Cell *cells;
+    u32 stride; // width + 2
+    i64 neighbours[8]; // offsets from a cell to its neighbours, row above first
+    /*
+     * Seed stack for explore()'s flood fill, allocated once per board
+     * Seeds are revealed as they're pushed so it can never hold more
+     * than num_cells, but it rarely gets past a few entries
+     */
+    u32 *fill_stack;
+    ChangeList changes; // see engine_clear_changes()
+    /*
+     * Optional bitplane mirror of the cells (see ENGINE_FLAG_BITPLANES)
+     * When enabled, whole-board queries are popcounts and masks over these
+     */
+    BitBoard bits;
+    bool use_bits;
+    bool bombs_placed; // see ENGINE_FLAG_SAFE_FIRST_CLICK
+    i64 bombs_left;
+    /*
+     * Cells are referred to by index (r * width + c) rather than pointer,
+     * so a board's memory can be moved, mapped or shared as it is
+     */
+    u32 cell_last_clicked; // BOARD_NO_CELL if none
+    u32 bomb_clicked; // BOARD_NO_CELL unless the game was lost
+    UndoLog *undo; // set while a move is being recorded
+    u64 num_cells; // == width * height
+    // explored cells that aren't bombs; the game is won when this hits num_cells - num_bombs
+    u64 num_safe_explored;
+    u32 num_bombs;
+    u32 width;
+    u32 height;
+} Board;
+
+static void board_idx_to_pos(Board *board, u64 idx, i64 *col, i64 *row)
+{
+    ASSERT(board);
+    ASSERT(col);
+    ASSERT(row);
+    ASSERT(idx < board->num_cells);
+    ASSERT(board->width > 0);
+
+    *col = idx % board->width;
+    *row = idx / board->width;
+}
+
+static Cell *board_pos_to_cell(Board *board, i64 c, i64 r)
+{
+    ASSERT(board);
+    ASSERT(board->cells);
+    ASSERT(c >= 0 && c < board->width);
+    ASSERT(r >= 0 && r < board->height);
+
+    return &board->cells[(u64)r * board->stride + (u64)c];
+}
+
+static u32 board_pos_to_idx(Board *board, i64 c, i64 r)
+{
+    ASSERT(board);
+    ASSERT(c >= 0 && c < board->width);
+    ASSERT(r >= 0 && r < board->height);
+
+    return (u32)((u64)r * board->width + (u64)c);
+}
+
+static Cell *board_idx_to_cell(Board *board, u64 idx)
+{
+    i64 c, r;
+    board_idx_to_pos(board, idx, &c, &r);
+    return board_pos_to_cell(board, c, r);
+}
+
+static void board_cell_to_pos(Board *board, Cell *cell, i64 *c, i64 *r)
+{
+    ASSERT(board);
+    ASSERT(board->cells);
+    ASSERT(cell >= board->cells);
+    ASSERT(board->stride > 0);
+
+    u64 offset = (u64)(cell - board->cells);
+    *c = offset % board->stride;
+    *r = offset / board->stride;
+    ASSERT(*c < board->width);
+    ASSERT(*r < board->height);
+}
+
+static u32 board_cell_to_idx(Board *board, Cell *cell)
+{
+    i64 c, r;
+    board_cell_to_pos(board, cell, &c, &r);
+    return board_pos_to_idx(board, c, r);
+}
+
+/*
+ * Number of cells set in plane (one of BITPLANE_*) in the 3x3 square
+ * around c, r, including c, r
+ * Uses the bitplanes if the board has them, otherwise the cells
+ */
+u32 board_count_around(Board *board, u32 plane, u32 c, u32 r);
+
+enum {
+    ENGINE_PLAYING = 0,
+    ENGINE_WON,
+    ENGINE_LOST
+};
+
+#define ENGINE_TIME_NONE UINT64_MAX
+
+/* engine_init() flags */
+// keep bomb/explored/flagged bitplanes alongside the cells
+#define ENGINE_FLAG_BITPLANES (1 << 0)
+/*
+ * Place bombs on the first reveal instead of in engine_new_game(),
+ * keeping them out of the 3x3 square around it (or just the cell itself,
+ * if the board is too full for that), so the first click never loses
+ */
+#define ENGINE_FLAG_SAFE_FIRST_CLICK (1 << 1)
+
+/*
+ * Called for each run of cells in row r, c0..c1 inclusive, that a
+ * reveal turns to CELL_EXPLORED, so callers can update incrementally
+ * Every revealed cell is reported exactly once
+ */
+typedef void (*EngineSpanFn)(void *data, u32 r, u32 c0, u32 c1);
+
+/*
+ * Everything needed to play one board
+ * The engine never reads a clock itself; callers pass in now_ms from
+ * whatever time source they like (SDL ticks, a simulated clock...)
+ */
+typedef struct {
+    Board board;
+    BumpAllocator arena; // board memory, handed over by engine_new_game()
+    Rng seed_rng; // picks seeds for games that don't set one
+    Rng rng; // this game's stream, seeded from params.seed
+    u64 time_started_ms; // ENGINE_TIME_NONE until the first reveal
+    u64 time_ms;
+    u8 status; // one of ENGINE_PLAYING, ENGINE_WON, ENGINE_LOST
+    u32 flags; // ENGINE_FLAG_*
+    GameParams params;
+    EngineSpanFn span_fn; // optional
+    void *span_data;
+    UndoLog undo; // empty unless engine_undo_init() was called
+} Engine;
+
+// bytes of memory engine_new_game() needs for a board of this size
+u64 engine_mem_size(u32 width, u32 height);
+
+// seed is only used for games started with params.seed == 0
+void engine_init(Engine *engine, u64 seed, u32 flags);
+/*
+ * Start a new game with params, using mem for all board storage
+ * The same params (including a nonzero seed) always give the same board
+ * mem must be at least engine_mem_size(params.width, params.height) bytes,
+ * and stay valid until the next engine_new_game()
+ */
+bool engine_new_game(Engine *engine, GameParams params, void *mem, u64 mem_size);
+
+// update time_ms if the game is running
+void engine_tick(Engine *engine, u64 now_ms);
+/*
+ * Empty board.changes, once everything watching it has caught up
+ * (the game does this once a frame)
+ */
+void engine_clear_changes(Engine *engine);
+/*
+ * Mark an unexplored cell as held down (CELL_CLICKED)
+ * Returns true if the cell changed
+ */
+bool engine_press(Engine *engine, u32 c, u32 r);
+// reset the held down cell back to unexplored
+void engine_release_press(Engine *engine);
+/*
+ * Explore an unexplored cell, flooding out from empty cells
+ * Starts the timer (and places bombs, with ENGINE_FLAG_SAFE_FIRST_CLICK)
+ * on the first reveal
+ * Returns true if the cell was explored
+ */
+bool engine_reveal(Engine *engine, u32 c, u32 r, u64 now_ms);
+/*
+ * Flag an unexplored cell, or unflag a flagged cell
+ * Returns true if the cell changed
+ */
+bool engine_toggle_flag(Engine *engine, u32 c, u32 r);
+
+// memory for an undo log of up to max_deltas cell changes
+u64 engine_undo_mem_size(u32 max_deltas);
+/*
+ * Start recording moves so they can be undone
+ * Call after engine_new_game(); later engine_new_game()s empty the log
+ * but keep using mem, so it has to live as long as the engine's memory
+ * A single move needs up to num_cells deltas, so max_deltas should be
+ * at least that or big moves can't be undone
+ * False if the board is too big to undo, or mem_size is less than
+ * engine_undo_mem_size(max_deltas)
+ */
+bool engine_undo_init(Engine *engine, u32 max_deltas, void *mem, u64 mem_size);
+// forget all moves, e.g. after moves the player shouldn't undo
+void engine_undo_clear(Engine *engine);
+/*
+ * Undo the last move (or redo the last undone one), including winning
+ * or losing. Doesn't call span_fn
+ * Returns false if there's nothing to undo (redo)
+ */
+bool engine_undo(Engine *engine);
+bool engine_redo(Engine *engine);
+// bytes of the undo log holding moves, including ones that can be redone
+u64 engine_undo_mem_used(Engine *engine);
+
+/*
+ * Bring the board's snapshot header up to date and return it
+ * The snapshot is the first size bytes from there, to be written out as is
+ */
+EngineSnapshot *engine_snapshot(Engine *engine, u64 now_ms, u64 *size);
+/*
+ * Check everything engine_load_snapshot() relies on, so a bad file can't
+ * take the engine out of bounds or leave a game that can't be won (logs
+ * why not)
+ * Reads the header, the border and the bitplanes; the cells inside the
+ * border are only read for a snapshot without bitplanes, to count them
+ */
+bool engine_snapshot_valid(void *snapshot, u64 size);
+/*
+ * Resume a game from a snapshot engine_snapshot_valid() accepted, e.g. a
+ * saved one mapped with platform_map_file(); the timer carries on from now_ms
+ * The cells and bitplanes are used in place, not copied, so snapshot must
+ * be writable and stay valid until the next engine_new_game() or load
+ * mem is for everything else, and must be engine_mem_size() bytes for
+ * the snapshot's width and height
+ * The undo log is emptied
+ */
+bool engine_load_snapshot(Engine *engine, void *snapshot, u64 snapshot_size, u64 now_ms,
+                          void *mem, u64 mem_size);
+
+C_END
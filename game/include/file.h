@@ -16,6 +16,9 @@ static char *file_read_to_string(const char *filename, u64 *len)
     return file_read(filename, len, true);
 }
 
+// create or overwrite filename with len bytes of data
+bool file_write(const char *filename, const void *data, u64 len);
+
 unsigned char *image_file_read(const char *filename, u64 *size, u32 *width, u32 *height);
 
 C_END
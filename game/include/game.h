@@ -1,6 +1,9 @@
 #pragma once
 #include"types.h"
 #include"vec.h"
+#include"engine.h"
+#include"noguess.h"
+#include"replay.h"
 
 C_BEGIN
 
@@ -23,79 +26,40 @@ C_BEGIN
 // interior height should be a multiple of BORDER_PIXEL_HEIGHT
 #define TOP_INTERIOR_HEIGHT ( (FACE_PIXEL_HEIGHT) + 20 + (BORDER_PIXEL_HEIGHT) )
 
-typedef struct {
-    u32 width;
-    u32 height;
-    u32 num_bombs;
-} GameParams;
-
 #define PARAMS_MIN_WIDTH 6
 #define PARAMS_MIN_HEIGHT 6
 #define PARAMS_MIN_BOMBS 5
-#define PARAMS_MAX_WIDTH 31
-#define PARAMS_MAX_HEIGHT 31
-#define PARAMS_MAX_BOMBS COUNTER_MAX
-static const GameParams game_easy = { 9, 9, 10 };
-static const GameParams game_medium = { 16, 16, 40 };
-static const GameParams game_hard = { 30, 16, 99 };
-static const GameParams game_custom_default = { 6, 31, 42 };
-
-enum {
-    CELL_UNEXPLORED = 0,
-    CELL_FLAGGED,
-    CELL_CLICKED,
-    CELL_EXPLORED
-};
-
-typedef struct {
-    u8 state;
-    u8 bombs_around;
-    bool is_bomb;
-} Cell;
-
-typedef struct {
-    Cell *cells;
-    i64 bombs_left;
-    Cell *cell_last_clicked;
-    Cell *bomb_clicked;
-    u32 num_cells; // == width * height
-    u32 num_bombs;
-    u32 width;
-    u32 height;
-} Board;
-
-static void board_idx_to_pos(Board *board, u32 idx, i64 *col, i64 *row)
-{
-    ASSERT(board);
-    ASSERT(col);
-    ASSERT(row);
-    ASSERT(idx < board->num_cells);
-    ASSERT(board->width > 0);
-
-    *col = idx % board->width;
-    *row = idx / board->width;
-}
-
-static Cell *board_pos_to_cell(Board *board, i64 c, i64 r)
-{
-    ASSERT(board);
-    ASSERT(board->cells);
-    ASSERT(c >= 0 && c < board->width);
-    ASSERT(r >= 0 && r < board->height);
-
-    return &board->cells[r * board->width + c];
-}
+#define PARAMS_MAX_WIDTH 16384
+#define PARAMS_MAX_HEIGHT 16384
+/*
+ * A board takes about 6 bytes a cell (see engine_mem_size()), plus an
+ * undo log capped at GAME_UNDO_MAX_DELTAS, so this keeps the biggest
+ * ones comfortably inside the scratch memory budget
+ */
+#define PARAMS_MAX_CELLS (1 << 27)
+// the bomb counter just shows COUNTER_MAX until enough flags are placed
+#define PARAMS_MAX_BOMBS (PARAMS_MAX_CELLS - 1)
 
-static void board_cell_to_pos(Board *board, Cell *cell, i64 *c, i64 *r)
-{
-    ASSERT(board);
-    ASSERT(board->cells);
-    ASSERT(cell >= board->cells);
-    ASSERT(cell < &board->cells[board->num_cells]);
+/*
+ * The cells are seen through a camera, which pans and zooms over the board
+ * inside a view of at most this many cells; so the window, and how many
+ * cells are drawn each frame, stay the same however big the board is
+ */
+#define GAME_VIEW_MAX_COLS 64
+#define GAME_VIEW_MAX_ROWS 40
+// every cell in view is drawn, so zooming out is limited
+#define CAMERA_ZOOM_MIN 0.25F
+#define CAMERA_ZOOM_MAX 4.0F
+// per mouse wheel notch
+#define CAMERA_ZOOM_STEP 2.0F
 
-    u32 idx = (u32)(cell - board->cells);
-    board_idx_to_pos(board, idx, c, r);
-}
+/*
+ * Multi-board mode: a square grid of boards of the same params, played at
+ * once, with GAME_MULTI_GAP_CELLS empty cells between them
+ * Finished boards are dealt again on their own when clicked
+ */
+#define GAME_MULTI_MAX_ACROSS 4
+#define GAME_MULTI_GAP_CELLS 1
 
 enum {
     FACE_SMILE = 0,
@@ -104,50 +68,245 @@ enum {
     FACE_COOL
 };
 
+enum {
+    REPLAY_MODE_NONE = 0,
+    REPLAY_MODE_RECORD,
+    REPLAY_MODE_PLAY
+};
+
 typedef struct {
+    u64 time_ms; // when the input was read; the game never reads the clock itself
+    u64 real_time_ms; // SDL ticks when it was read, only for measuring input latency
     u32 mouse_x;
     u32 mouse_y;
     bool mouse_left_down;
     bool mouse_right_down;
+    bool mouse_middle_down; // drags the camera
+    i8 zoom; // mouse wheel notches, + to zoom in; only from queued events
+    bool undo_key; // ctrl+z
+    bool redo_key; // ctrl+y or ctrl+shift+z
 #ifdef DEBUG
     bool debug_key;
 #endif
 } Input;
 
+/*
+ * Button and key events from SDL, queued in order between ticks, so a
+ * press and release that both land between two ticks still make a click
+ * time_ms is SDL's event timestamp (real time, not game time)
+ */
+enum {
+    INPUT_BUTTON_LEFT = 0,
+    INPUT_BUTTON_RIGHT,
+    INPUT_BUTTON_UNDO,
+    INPUT_BUTTON_REDO,
+    INPUT_BUTTON_ZOOM_IN, // mouse wheel, down only
+    INPUT_BUTTON_ZOOM_OUT
+};
+
 typedef struct {
-    Board board;
-    Input last_input; // input from previous frame
-    u64 time_started_ms;
     u64 time_ms;
+    u32 mouse_x; // window pixels, for mouse buttons
+    u32 mouse_y;
+    u8 button; // INPUT_BUTTON_*
+    bool down;
+} InputEvent;
+
+// power of 2; there's rarely more than a couple of events between ticks
+#define INPUT_QUEUE_LEN 64
+
+typedef struct {
+    InputEvent events[INPUT_QUEUE_LEN];
+    u32 head; // next to pop
+    u32 tail; // next to push; empty when head == tail
+    u64 num_dropped; // pushed while full
+} InputQueue;
+
+static bool input_queue_push(InputQueue *queue, const InputEvent *event)
+{
+    if (queue->tail - queue->head == INPUT_QUEUE_LEN) {
+        queue->num_dropped++;
+        return false;
+    }
+    queue->events[queue->tail++ & (INPUT_QUEUE_LEN - 1)] = *event;
+    return true;
+}
+
+static bool input_queue_pop(InputQueue *queue, InputEvent *event)
+{
+    if (queue->head == queue->tail) {
+        return false;
+    }
+    *event = queue->events[queue->head++ & (INPUT_QUEUE_LEN - 1)];
+    return true;
+}
+
+typedef struct {
+    Vec2f pos; // play area pixel at the top left of the view
+    f32 zoom; // game pixels per play area pixel
+} Camera;
+
+/*
+ * One of the boards in multi-board mode
+ * Everything it uses (the engine's memory and its undo log) comes from
+ * its arena, so it's torn down on its own with a bump_reset()
+ */
+typedef struct {
+    Engine engine;
+    BumpAllocator arena;
+} GameBoard;
+
+typedef struct {
+    Engine engine; // board, rng and timer; multi-board mode uses boards instead
+    u32 multi_across; // boards across (and down) from the menu, for the next game; 1 for just engine
+    u32 boards_across; // this game's, 0 unless it's multi-board
+    GameBoard *boards; // boards_across * boards_across, in scratch scope 0
+    Input last_input; // input from previous tick
+    Camera camera;
     u8 face_state; // one of FACE_SMILE, FACE_SCARED, etc
     bool face_clicked;
-    bool playing; // cells can be clicked on
     u32 window_scale; // game is scaled down by >>window_scale
     bool window_needs_resize;
     f32 main_menu_bar_height_window_px; // 'native' height of top menu bar; not scaled by window_scale
     GameParams params; // last params used to start the game, reused when face clicked on
+    void *engine_mem; // board memory, lives in scratch scope 0
+    u64 engine_mem_size;
+    void *snapshot_mem; // the mapped save a loaded board's cells live in, if any
+    u64 snapshot_mem_size;
+    bool save_requested; // from the menu, handled at the end of the frame
+    bool load_requested;
+    bool no_guess; // only play boards that can be won without guessing
+    bool generating; // the board isn't playable until no_guess_gen finds one
+    NoGuessGen no_guess_gen;
+    JobSystem jobs; // one worker per cpu, for anything that can run off the main thread
+    u8 replay_mode; // REPLAY_MODE_*
+    Replay replay;
+    const char *replay_path; // where the recording is saved
+    bool replay_fast; // play back as fast as possible rather than in real time
+    bool replay_clock_started;
+    i64 replay_clock_offset_ms; // replay time - game time, for real time playback
+    Input replay_input; // last input played back
+    Camera replay_camera; // last camera recorded
+    InputQueue input_queue; // filled by main between ticks, drained by game_update()
+    // how long queued input waited to be handled, in real time
+    u64 input_latency_sum_ms;
+    u64 input_latency_max_ms;
+    u64 num_input_events;
+    bool idle_render; // only draw when something on screen changes, see game_needs_render()
+    // what the last frame showed
+    bool drawn;
+    u8 drawn_face_state;
+    bool drawn_face_clicked;
+    u32 drawn_timer;
+    Camera drawn_camera;
 } GameState;
 
 extern GameState game_state;
 
+static u32 game_num_boards()
+{
+    return game_state.boards_across ? game_state.boards_across * game_state.boards_across : 1;
+}
+
+// boards are numbered across then down
+static Engine *game_engine(u32 i)
+{
+    ASSERT(i < game_num_boards());
+    return game_state.boards_across ? &game_state.boards[i].engine : &game_state.engine;
+}
+
+// seconds the timer counter shows; the longest running board's
+static u32 game_timer_shown()
+{
+    u64 elapsed_ms = 0;
+    for (u32 i = 0; i < game_num_boards(); ++i) {
+        Engine *engine = game_engine(i);
+        if (engine->time_ms == ENGINE_TIME_NONE) {
+            continue;
+        }
+        ASSERT(engine->time_ms >= engine->time_started_ms);
+        elapsed_ms = MAX(elapsed_ms, engine->time_ms - engine->time_started_ms);
+    }
+    return (u32)MIN(elapsed_ms / 1000, COUNTER_MAX);
+}
+
+/*
+ * The play area: every board and the gaps between them, in cells
+ * Cells are drawn and picked in play area coordinates, which are just
+ * the board's with only the one
+ */
+static u32 play_area_cols()
+{
+    u32 across = MAX(game_state.boards_across, 1);
+    return across * game_engine(0)->params.width + (across - 1) * GAME_MULTI_GAP_CELLS;
+}
+
+static u32 play_area_rows()
+{
+    u32 across = MAX(game_state.boards_across, 1);
+    return across * game_engine(0)->params.height + (across - 1) * GAME_MULTI_GAP_CELLS;
+}
+
+// top left cell of board i in the play area
+static void play_area_board_pos(u32 i, i64 *col, i64 *row)
+{
+    u32 across = MAX(game_state.boards_across, 1);
+    GameParams *params = &game_engine(0)->params;
+    *col = (i64)(i % across) * (params->width + GAME_MULTI_GAP_CELLS);
+    *row = (i64)(i / across) * (params->height + GAME_MULTI_GAP_CELLS);
+}
+
+// the board, and its cell, at a play area cell; false in a gap or outside
+static bool play_area_to_board(i64 col, i64 row, u32 *board_idx, u32 *c, u32 *r)
+{
+    u32 across = MAX(game_state.boards_across, 1);
+    GameParams *params = &game_engine(0)->params;
+    i64 pitch_x = params->width + GAME_MULTI_GAP_CELLS;
+    i64 pitch_y = params->height + GAME_MULTI_GAP_CELLS;
+    if (col < 0 || row < 0 || col / pitch_x >= across || row / pitch_y >= across ||
+        col % pitch_x >= params->width || row % pitch_y >= params->height) {
+        return false;
+    }
+    *board_idx = (u32)((row / pitch_y) * across + col / pitch_x);
+    *c = (u32)(col % pitch_x);
+    *r = (u32)(row % pitch_y);
+    return true;
+}
+
 static f32 menu_bar_y_offset_px()
 {
     return (f32)((u32)game_state.main_menu_bar_height_window_px << game_state.window_scale);
 }
 
+// cells across and down the view, at zoom 1
+static u32 view_cols()
+{
+    return MIN(play_area_cols(), GAME_VIEW_MAX_COLS);
+}
+
+static u32 view_rows()
+{
+    return MIN(play_area_rows(), GAME_VIEW_MAX_ROWS);
+}
+
+static Vec2f view_dims_px()
+{
+    return vec2f((f32)(view_cols() * CELL_PIXEL_WIDTH), (f32)(view_rows() * CELL_PIXEL_HEIGHT));
+}
+
 static Vec2f game_dims_px()
 {
     return vec2f(
-        (f32)(((BORDER_PIXEL_WIDTH) * 2) + (game_state.params.width * CELL_PIXEL_WIDTH)),
-        (f32)((BORDER_PIXEL_HEIGHT * 3) + (game_state.params.height * CELL_PIXEL_HEIGHT) + TOP_INTERIOR_HEIGHT + (u32)menu_bar_y_offset_px())
+        (f32)(((BORDER_PIXEL_WIDTH) * 2) + (view_cols() * CELL_PIXEL_WIDTH)),
+        (f32)((BORDER_PIXEL_HEIGHT * 3) + (view_rows() * CELL_PIXEL_HEIGHT) + TOP_INTERIOR_HEIGHT + (u32)menu_bar_y_offset_px())
     );
 }
 
 static Vec2f game_dims_px_no_menu()
 {
     return vec2f(
-        (f32)(((BORDER_PIXEL_WIDTH) * 2) + (game_state.params.width * CELL_PIXEL_WIDTH)),
-        (f32)((BORDER_PIXEL_HEIGHT * 3) + (game_state.params.height * CELL_PIXEL_HEIGHT) + TOP_INTERIOR_HEIGHT)
+        (f32)(((BORDER_PIXEL_WIDTH) * 2) + (view_cols() * CELL_PIXEL_WIDTH)),
+        (f32)((BORDER_PIXEL_HEIGHT * 3) + (view_rows() * CELL_PIXEL_HEIGHT) + TOP_INTERIOR_HEIGHT)
     );
 }
 
@@ -159,6 +318,15 @@ static Vec2f cells_offset_px()
     );
 }
 
+// game pixels to play area pixels; the inverse of the camera transform cells are drawn with
+static Vec2f camera_to_play_area_px(Vec2f pos)
+{
+    Camera *camera = &game_state.camera;
+    Vec2f offset = cells_offset_px();
+    return vec2f(camera->pos.x + (pos.x - offset.x) / camera->zoom,
+                 camera->pos.y + (pos.y - offset.y) / camera->zoom);
+}
+
 static f32 top_interior_center_y_px()
 {
     return (f32)(BORDER_PIXEL_HEIGHT + (TOP_INTERIOR_HEIGHT / 2) + (u32)menu_bar_y_offset_px());
@@ -200,11 +368,52 @@ bool gui_difficulty(GameParams *params);
 
 void draw_game();
 void draw_resize();
-void draw_end_game(Board *board);
-bool draw_start_game(Board* board);
+void draw_end_game();
+bool draw_start_game();
 bool draw_init();
 
-bool game_update_and_render(Input input);
+/*
+ * The game updates at a fixed rate, decoupled from how often frames are
+ * drawn: main's loop runs however many ticks of game time have passed,
+ * then draws once. Game time (Input.time_ms) only moves on by ticks
+ */
+#define GAME_TICKS_PER_SEC 120
+#define GAME_TICK_NS (1000000000ull / GAME_TICKS_PER_SEC)
+// after a long stall (a breakpoint, a dragged window) don't try to catch all of it up
+#define GAME_MAX_FRAME_NS (250 * 1000000ull)
+// ticks per frame when playing a replay back as fast as possible
+#define GAME_FAST_TICKS_PER_FRAME 1024
+
+// one tick; returns false when the game should quit (including when a replay ends)
+bool game_update(Input input);
+// draw the current state, along with the menus
+void game_render();
+
+/*
+ * Idle rendering: rather than drawing every vsync, main's loop sleeps in
+ * SDL_WaitEventTimeout() until there's input, or for game_idle_wait_ms(),
+ * and only draws when there was input or game_needs_render()
+ */
+// the longest to sleep without checking on anything
+#define GAME_IDLE_MAX_WAIT_MS 1000
+// how often to check on a no-guess board being generated
+#define GAME_IDLE_POLL_MS 50
+// frames to keep drawing after input, so imgui's hovering and menus settle
+#define GAME_IDLE_SETTLE_FRAMES 3
+
+// a cell, the face or a counter has changed since the last frame
+bool game_needs_render();
+// how long nothing on screen can change for without input
+u32 game_idle_wait_ms();
 bool game_init();
 
+/*
+ * Record the session to path, written out by game_replay_save(), or play
+ * path back in place of the player's input
+ * Call before game_init(), so the first game is part of the replay
+ */
+bool game_replay_record(const char *path);
+bool game_replay_play(const char *path, bool fast);
+bool game_replay_save();
+
 C_END
@@ -0,0 +1,88 @@
+/*
+ * Work-stealing job system
+ * A fixed pool of worker threads, each with its own deque of jobs
+ * Workers push and pop their own deque at the bottom (newest first, so
+ * children run while their data is still in cache), and when it's empty
+ * they steal the oldest job from the top of someone else's
+ *
+ * Threads outside the pool (e.g. the main thread) submit to a shared
+ * deque that all the workers steal from, and can run jobs themselves
+ * while they wait for a counter
+ */
+#pragma once
+#include"types.h"
+#include"platform.h"
+
+C_BEGIN
+
+#define JOB_MAX_THREADS 64
+
+typedef void (*JobFn)(void *data);
+
+/*
+ * Jobs submitted with this counter that haven't returned yet
+ * A job may submit children on the same counter it was submitted with;
+ * they're added before the parent returns, so the counter only reaches 0
+ * once the whole tree is done
+ */
+typedef struct {
+    volatile u32 pending;
+} JobCounter;
+
+typedef struct {
+    JobFn fn;
+    void *data;
+    JobCounter *counter; // optional
+} Job;
+
+typedef struct {
+    volatile u32 lock;
+    u64 top; // oldest job; thieves take from here
+    u64 bottom; // one past the newest; the owner pushes and pops here
+    u32 capacity;
+    Job *jobs; // ring buffer, indexed by top/bottom % capacity
+} JobDeque;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct {
+    JobSystem *system;
+    JobDeque deque;
+    u32 index;
+    u32 steal_seed; // for picking who to steal from
+    PlatformThread *thread;
+} JobWorker;
+
+struct JobSystem {
+    JobWorker workers[JOB_MAX_THREADS];
+    u32 num_workers;
+    JobDeque external; // jobs from threads outside the pool
+    PlatformSemaphore *wake; // posted once per job submitted, so idle workers can sleep
+    volatile u32 stopping;
+};
+
+// memory job_system_start() needs
+u64 job_system_mem_size(u32 num_threads, u32 deque_capacity);
+/*
+ * Start num_threads workers (0 means one per cpu)
+ * Each deque holds deque_capacity jobs; job_submit() runs jobs straight
+ * away rather than queueing them when a deque is full
+ * mem must be job_system_mem_size() bytes and live until job_system_stop()
+ */
+bool job_system_start(JobSystem *system, u32 num_threads, u32 deque_capacity,
+                      void *mem, u64 mem_size);
+// run everything already submitted, then stop the workers
+void job_system_stop(JobSystem *system);
+
+/*
+ * Queue count jobs, adding count to counter first
+ * Each job's counter is overwritten with counter
+ */
+void job_submit(JobSystem *system, Job *jobs, u32 count, JobCounter *counter);
+// run jobs on this thread until counter reaches 0
+void job_wait(JobSystem *system, JobCounter *counter);
+
+// true once every job on counter has returned, without blocking
+bool job_counter_done(JobCounter *counter);
+
+C_END
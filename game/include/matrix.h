@@ -18,6 +18,45 @@ static Mat4 mat4_ident()
     return m;
 }
 
+static Mat4 mat4_translate(f32 x, f32 y, f32 z)
+{
+    // rightmost column -> bottommost row, see mat4_ortho()
+    Mat4 m = {{
+             1, 0, 0, 0,
+             0, 1, 0, 0,
+             0, 0, 1, 0,
+             x, y, z, 1
+           }};
+    return m;
+}
+
+static Mat4 mat4_scale(f32 x, f32 y, f32 z)
+{
+    Mat4 m = {{
+             x, 0, 0, 0,
+             0, y, 0, 0,
+             0, 0, z, 0,
+             0, 0, 0, 1
+           }};
+    return m;
+}
+
+// a * b, i.e. b is applied first
+static Mat4 mat4_mul(const Mat4 *a, const Mat4 *b)
+{
+    Mat4 m;
+    for (u32 col = 0; col < 4; ++col) {
+        for (u32 row = 0; row < 4; ++row) {
+            f32 sum = 0;
+            for (u32 i = 0; i < 4; ++i) {
+                sum += a->data[i * 4 + row] * b->data[col * 4 + i];
+            }
+            m.data[col * 4 + row] = sum;
+        }
+    }
+    return m;
+}
+
 #ifdef _WIN32
 /* WTF windows */
 #undef far
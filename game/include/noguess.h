@@ -0,0 +1,70 @@
+/*
+ * No-guess board generator
+ * Tries candidate boards as jobs on a JobSystem, keeping the first one
+ * the solver can win from the opening click without guessing
+ *
+ * A candidate is just a seed: with ENGINE_FLAG_SAFE_FIRST_CLICK, the same
+ * params + seed + first reveal always gives the same board, so the result
+ * is handed back as params.seed for engine_new_game()
+ */
+#pragma once
+#include"types.h"
+#include"job.h"
+#include"engine.h"
+#include"solver.h"
+
+C_BEGIN
+
+#define NOGUESS_MAX_THREADS JOB_MAX_THREADS
+
+typedef struct NoGuessGen NoGuessGen;
+
+typedef struct {
+    NoGuessGen *gen;
+    Engine engine;
+    Solver solver;
+    void *engine_mem; // engine_mem_size() bytes
+    void *solver_mem; // solver_mem_size() bytes
+} NoGuessWorker;
+
+struct NoGuessGen {
+    JobSystem *jobs;
+    GameParams params; // params.seed is the base all candidate seeds come from
+    u32 first_c;
+    u32 first_r;
+    u64 max_candidates;
+    // one job per worker, each pulling candidates until there's an answer
+    NoGuessWorker workers[NOGUESS_MAX_THREADS];
+    u32 num_workers;
+    JobCounter counter;
+    /* shared between the workers */
+    volatile u64 next_candidate;
+    volatile u64 found; // lowest winning candidate so far, UINT64_MAX for none yet
+    volatile u32 cancelled;
+};
+
+// memory noguess_start() needs for num_workers workers
+u64 noguess_mem_size(u32 width, u32 height, u32 num_workers);
+/*
+ * Start looking for a board for params that can be won without guessing
+ * after revealing first_c, first_r
+ * Gives up after max_candidates boards
+ * Runs as num_workers jobs on jobs, usually one per worker thread
+ * mem must be noguess_mem_size() bytes, 16 aligned, and live until noguess_finish()
+ */
+bool noguess_start(NoGuessGen *gen, JobSystem *jobs, GameParams params, u32 first_c, u32 first_r,
+                   u64 max_candidates, u32 num_workers, void *mem, u64 mem_size);
+// true once all the workers have stopped, without blocking
+bool noguess_done(NoGuessGen *gen);
+// stop the workers at their next candidate; noguess_finish() still has to be called
+void noguess_cancel(NoGuessGen *gen);
+/*
+ * Wait for the workers (helping them if called from outside the job
+ * system's threads) and clean up
+ * Returns true and sets *seed if a board was found (and not cancelled)
+ * The result doesn't depend on timing or thread count: it's always the
+ * lowest numbered winning candidate
+ */
+bool noguess_finish(NoGuessGen *gen, u64 *seed);
+
+C_END
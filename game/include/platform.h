@@ -7,9 +7,45 @@ C_BEGIN
 
 void platform_console_print(const char *ptr, size_t len);
 
+// milliseconds since platform_init()
+u64 platform_ticks_ms();
+// nanoseconds from some arbitrary start; for timing
+u64 platform_ticks_ns();
+// cpu time used by the process so far, all threads, in nanoseconds
+u64 platform_cpu_time_ns();
+
 void *platform_alloc_page_aligned(size_t size);
 bool platform_free_page_aligned(void *ptr);
 
+/*
+ * Map a whole file into memory, copy on write: it can be written to,
+ * but changes never go back to the file
+ * Returns NULL on failure (or if the file is empty), size is the file's
+ */
+void *platform_map_file(const char *path, u64 *size);
+bool platform_unmap_file(void *ptr, u64 size);
+
+typedef struct PlatformThread PlatformThread;
+typedef void (*PlatformThreadFn)(void *data);
+
+// run fn(data) on a new thread; NULL on failure
+PlatformThread *platform_thread_start(PlatformThreadFn fn, void *data);
+// wait for the thread to return, and free it
+void platform_thread_join(PlatformThread *thread);
+// logical cpus available, at least 1
+u32 platform_num_cpus();
+// give up the rest of this thread's time slice
+void platform_thread_yield();
+
+typedef struct PlatformSemaphore PlatformSemaphore;
+
+// NULL on failure
+PlatformSemaphore *platform_semaphore_create(u32 count);
+void platform_semaphore_destroy(PlatformSemaphore *sem);
+// block until the count is above 0, then take 1 off it
+void platform_semaphore_wait(PlatformSemaphore *sem);
+void platform_semaphore_post(PlatformSemaphore *sem, u32 count);
+
 bool platform_init();
 
 C_END
@@ -0,0 +1,51 @@
+/*
+ * Exact bomb probabilities for every unexplored cell
+ * For when the solver is stuck and something has to be guessed
+ *
+ * The frontier (unexplored cells next to numbers) is split into
+ * components that share no numbers, so each can be enumerated on its own
+ * with backtracking. Components are combined through the total number of
+ * bombs: a way to put t bombs in the frontier is weighted by the ways to
+ * put the rest in the cells off the frontier, C(off_frontier, bombs - t),
+ * done in log space since those get huge
+ *
+ * Like the solver, player flags are ignored
+ */
+#pragma once
+#include"types.h"
+#include"engine.h"
+
+C_BEGIN
+
+typedef struct {
+    /*
+     * Per cell, num_cells long
+     * 0 for explored cells; other cells off the frontier all share one probability
+     */
+    f32 *bomb_prob;
+    u32 num_frontier;
+    u32 num_components;
+    u32 largest_component; // cells
+    u64 num_nodes; // backtracking steps taken, over both passes
+} Prob;
+
+/*
+ * Memory prob_compute() needs for a board this size
+ * Grows with the square of the cell count (for combining components), so
+ * it's meant for boards up to a few thousand cells
+ */
+u64 prob_mem_size(u32 width, u32 height);
+/*
+ * Fill in prob->bomb_prob for board's current state
+ * Gives up and returns false after max_nodes backtracking steps in either
+ * of its two passes (0 for no limit), or if the explored cells contradict
+ * each other
+ */
+bool prob_compute(Prob *prob, Board *board, void *mem, u64 mem_size, u64 max_nodes);
+/*
+ * Unexplored, unflagged cell least likely to be a bomb, after prob_compute()
+ * Returns false if there are none
+ */
+bool prob_safest(Prob *prob, Board *board, u32 *c, u32 *r);
+
+C_END
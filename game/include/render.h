@@ -1,6 +1,7 @@
 #pragma once
 #include"glad/glad.h"
 #include"types.h"
+#include"matrix.h"
 C_BEGIN
 
 /*
@@ -68,6 +69,11 @@ typedef struct {
 void shader_set_texture_array(GLuint shader_id, glTextureArray* texture_array);
 void shader_set_color(GLuint shader_id, Color color);
 void shader_set_transform_pixels(GLuint shader_id, f32 width, f32 height);
+// view matrix applied before the pixel transform, e.g. a camera; identity by default
+void shader_set_view(GLuint shader_id, const Mat4 *view);
+// only draw inside this rectangle, in shader_set_transform_pixels() pixels
+void render_clip_pixels(f32 x, f32 y, f32 width, f32 height);
+void render_clip_none();
 
 glTextureArray *create_texture_array(SpriteSheetImage* images, u32 count);
 glTexture *create_texture(void* image_data, u32 width, u32 height);
@@ -0,0 +1,87 @@
+/*
+ * Replays: every game started (with the seed it actually used) and the
+ * player's input whenever it changes, so a session can be played back
+ * exactly, e.g. as a benchmark workload
+ *
+ * Headless; the game decides what to record and when, this is just the
+ * encoding. Everything is varints, deltas against the previous event:
+ *   "BSRP", version byte, then per event:
+ *     header byte: bits 0-1 REPLAY_EVENT_*, bit 2 REPLAY_HEADER_FLAG,
+ *                  bits 4-7 REPLAY_BUTTON_* (INPUT only)
+ *     varint ms since the previous event (since 0 for the first)
+ *     INPUT: if flagged (the mouse moved), zigzag varint dx, dy
+ *     GAME_START: varint width, height, num_bombs, seed; flagged if no-guess
+ *     BOARD: varint seed of the no-guess board found, 0 if none was
+ *     CAMERA: varint bits of the f32s x, y, zoom; the camera after the last input
+ * so a typical mouse move is 4 bytes and a click 2
+ */
+#pragma once
+#include"types.h"
+#include"engine.h"
+
+C_BEGIN
+
+#define REPLAY_MAGIC "BSRP"
+#define REPLAY_VERSION 2
+
+enum {
+    REPLAY_EVENT_INPUT = 0,
+    REPLAY_EVENT_GAME_START,
+    REPLAY_EVENT_BOARD,
+    REPLAY_EVENT_CAMERA
+};
+
+#define REPLAY_HEADER_FLAG (1 << 2)
+
+#define REPLAY_BUTTON_LEFT (1 << 0)
+#define REPLAY_BUTTON_RIGHT (1 << 1)
+#define REPLAY_BUTTON_UNDO (1 << 2)
+#define REPLAY_BUTTON_REDO (1 << 3)
+
+typedef struct {
+    u8 type; // REPLAY_EVENT_*
+    u64 time_ms;
+    // REPLAY_EVENT_INPUT
+    u32 mouse_x;
+    u32 mouse_y;
+    u8 buttons; // REPLAY_BUTTON_*
+    // REPLAY_EVENT_GAME_START, with the seed the engine actually used
+    GameParams params;
+    bool no_guess;
+    // REPLAY_EVENT_BOARD
+    u64 seed;
+    // REPLAY_EVENT_CAMERA
+    f32 camera_x;
+    f32 camera_y;
+    f32 camera_zoom;
+} ReplayEvent;
+
+/*
+ * A replay being written to, or read from, a buffer
+ * The writer never grows its buffer; once it's full, events are dropped
+ * and full is set, so a long session can't eat the memory budget
+ */
+typedef struct {
+    u8 *data;
+    u64 len; // bytes written, or bytes to read
+    u64 capacity;
+    u64 pos; // read position
+    bool full;
+    // previous event, which the next is delta encoded against (all 0 at the start)
+    u64 time_ms;
+    u32 mouse_x;
+    u32 mouse_y;
+    u8 buttons;
+} Replay;
+
+void replay_init_writer(Replay *replay, void *mem, u64 mem_size);
+// data must stay valid while reading; false if it isn't a replay we understand
+bool replay_init_reader(Replay *replay, const void *data, u64 len);
+
+void replay_write(Replay *replay, const ReplayEvent *event);
+// false at the end of the replay, or if it's truncated or corrupt
+bool replay_read(Replay *replay, ReplayEvent *event);
+// read the next event without consuming it
+bool replay_peek(Replay *replay, ReplayEvent *event);
+
+C_END
@@ -0,0 +1,28 @@
+/*
+ * Small seedable PRNG, xoshiro256**
+ * All state is explicit, so every board, replay and benchmark is
+ * reproducible from its seed, and threads can each own a stream
+ */
+#pragma once
+#include"types.h"
+
+C_BEGIN
+
+typedef struct {
+    u64 s[4];
+} Rng;
+
+// seed == 0 is fine; the state is expanded from it with splitmix64
+void rng_seed(Rng *rng, u64 seed);
+u64 rng_next(Rng *rng);
+/*
+ * Advance by 2^128 calls to rng_next()
+ * Seed once, then copy and jump to get non-overlapping streams
+ */
+void rng_jump(Rng *rng);
+// uniform in [0, bound), without modulo bias; bound must be > 0
+u64 rng_below(Rng *rng, u64 bound);
+// uniform in [0, 1)
+f64 rng_f64(Rng *rng);
+
+C_END
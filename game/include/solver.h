@@ -0,0 +1,69 @@
+/*
+ * Deduction solver
+ * Finds unexplored cells that are certainly safe or certainly bombs,
+ * from the numbers on the board, without ever guessing
+ *
+ * Each explored number is a constraint: its unknown neighbours hold
+ * bombs_around minus the known bombs around it. Constraints whose cells
+ * change go on a work queue, and each one is checked on its own and
+ * against every constraint it overlaps (the subset / 1-2-1 rules)
+ *
+ * Player flags are ignored; only bombs the solver deduced count as known
+ */
+#pragma once
+#include"types.h"
+#include"engine.h"
+
+C_BEGIN
+
+enum {
+    SOLVER_UNKNOWN = 0,
+    SOLVER_SAFE,
+    SOLVER_BOMB
+};
+
+typedef struct {
+    Board *board;
+    u8 *known; // SOLVER_* per cell
+    u8 *queued; // 1 if the cell's constraint is on the queue
+    // ring of explored number cells to recheck; a cell is only ever on it once
+    u32 *queue;
+    u64 queue_head;
+    u64 queue_len;
+    /*
+     * Everything deduced since solver_init(), in order, as cell indices
+     * Callers keep their own count of how many they've used
+     */
+    u32 *safe;
+    u64 num_safe;
+    u32 *bombs;
+    u64 num_bombs;
+    u64 num_checks; // constraints taken off the queue, for stats
+} Solver;
+
+u64 solver_mem_size(u32 width, u32 height);
+/*
+ * Start solving board from its current state
+ * mem must be solver_mem_size() bytes and live as long as the solver
+ */
+void solver_init(Solver *solver, Board *board, void *mem, u64 mem_size);
+/*
+ * Work through the queue until nothing more can be deduced
+ * Returns the number of new safe cells + bombs
+ */
+u64 solver_deduce(Solver *solver);
+/*
+ * Tell the solver about newly explored cells in row r, c0..c1
+ * Has the signature of an EngineSpanFn, so it can be hooked straight
+ * up to engine->span_fn with the solver as span_data
+ */
+void solver_on_reveal(void *solver, u32 r, u32 c0, u32 c1);
+
+/*
+ * From the board's current state, keep revealing cells the solver finds
+ * safe (and flagging the bombs) until stuck or the game is over
+ * Returns true if the game was won
+ */
+bool solver_play(Solver *solver, Engine *engine, void *mem, u64 mem_size);
+
+C_END
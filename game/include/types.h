@@ -71,6 +71,13 @@ typedef double f64;
 #define CLZ_U64(x) \
     __builtin_clzll((u64)(x))
 
+// x != 0
+#define CTZ_U64(x) \
+    __builtin_ctzll((u64)(x))
+
+#define POPCOUNT_U64(x) \
+    __builtin_popcountll((u64)(x))
+
 #endif
 
 #ifdef _WIN32
@@ -78,6 +85,13 @@ typedef double f64;
 #define CLZ_U64(x) \
     __lzcnt64((u64)(x))
 
+// x != 0; runs as bsf on cpus without tzcnt, which is the same for x != 0
+#define CTZ_U64(x) \
+    _tzcnt_u64((u64)(x))
+
+#define POPCOUNT_U64(x) \
+    __popcnt64((u64)(x))
+
 #endif
 
 // TODO these as functions, instead?
@@ -119,6 +133,14 @@ static_assert(CLZ_U64(1) == 63, "CLZ");
 static_assert(CLZ_U64(1ULL<<62) == 1, "CLZ");
 static_assert(CLZ_U64(1ULL<<63) == 0, "CLZ");
 
+static_assert(CTZ_U64(1) == 0, "CTZ");
+static_assert(CTZ_U64(1ULL<<63) == 63, "CTZ");
+static_assert(CTZ_U64(6) == 1, "CTZ");
+
+static_assert(POPCOUNT_U64(0) == 0, "POPCOUNT");
+static_assert(POPCOUNT_U64(7) == 3, "POPCOUNT");
+static_assert(POPCOUNT_U64(UINT64_MAX) == 64, "POPCOUNT");
+
 static_assert(ALIGN_UP(0, 1) == 0, "ALIGN_UP");
 static_assert(ALIGN_UP(1, 1) == 1, "ALIGN_UP");
 static_assert(ALIGN_UP(0, 2) == 0, "ALIGN_UP");
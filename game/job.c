@@ -0,0 +1,274 @@
+#include"types.h"
+#include"log.h"
+#include"atomic.h"
+#include"platform.h"
+#include"job.h"
+
+C_BEGIN
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// the worker running on this thread, NULL outside any pool
+static THREAD_LOCAL JobWorker *current_worker;
+
+/*
+ * Deques are guarded by a spinlock rather than being lock free
+ * Owners only contend with thieves, and thieves only show up when they've
+ * run out of work, so the lock is almost always taken uncontended
+ */
+static void deque_lock(JobDeque *deque)
+{
+    u32 expected = 0;
+    while (!atomic_cas_u32(&deque->lock, &expected, 1)) {
+        expected = 0;
+    }
+}
+
+static void deque_unlock(JobDeque *deque)
+{
+    atomic_store_u32(&deque->lock, 0);
+}
+
+static void deque_init(JobDeque *deque, Job *jobs, u32 capacity)
+{
+    deque->lock = 0;
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->capacity = capacity;
+    deque->jobs = jobs;
+}
+
+// false if the deque is full
+static bool deque_push(JobDeque *deque, Job job)
+{
+    deque_lock(deque);
+    bool ok = deque->bottom - deque->top < deque->capacity;
+    if (ok) {
+        deque->jobs[deque->bottom % deque->capacity] = job;
+        deque->bottom++;
+    }
+    deque_unlock(deque);
+    return ok;
+}
+
+// newest job, for the owner
+static bool deque_pop(JobDeque *deque, Job *job)
+{
+    deque_lock(deque);
+    bool ok = deque->bottom > deque->top;
+    if (ok) {
+        deque->bottom--;
+        *job = deque->jobs[deque->bottom % deque->capacity];
+    }
+    deque_unlock(deque);
+    return ok;
+}
+
+// oldest job, for thieves
+static bool deque_steal(JobDeque *deque, Job *job)
+{
+    deque_lock(deque);
+    bool ok = deque->bottom > deque->top;
+    if (ok) {
+        *job = deque->jobs[deque->top % deque->capacity];
+        deque->top++;
+    }
+    deque_unlock(deque);
+    return ok;
+}
+
+static JobWorker *worker_in(JobSystem *system)
+{
+    JobWorker *worker = current_worker;
+    return worker && worker->system == system ? worker : NULL;
+}
+
+/*
+ * Next job for this thread: its own deque if it's a worker, then the
+ * external deque, then the other workers, starting at a random one so
+ * thieves spread out
+ */
+static bool find_job(JobSystem *system, Job *job)
+{
+    JobWorker *self = worker_in(system);
+    if (self && deque_pop(&self->deque, job)) {
+        return true;
+    }
+    if (deque_steal(&system->external, job)) {
+        return true;
+    }
+    u32 start = 0;
+    if (self) {
+        // xorshift32
+        u32 x = self->steal_seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        self->steal_seed = x;
+        start = x % system->num_workers;
+    }
+    for (u32 i = 0; i < system->num_workers; ++i) {
+        JobWorker *victim = &system->workers[(start + i) % system->num_workers];
+        if (victim != self && deque_steal(&victim->deque, job)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_job(Job *job)
+{
+    job->fn(job->data);
+    if (job->counter) {
+        atomic_fetch_add_u32(&job->counter->pending, (u32)-1);
+    }
+}
+
+static void worker_main(void *data)
+{
+    JobWorker *worker = (JobWorker *)data;
+    JobSystem *system = worker->system;
+    current_worker = worker;
+
+    while (true) {
+        Job job;
+        if (find_job(system, &job)) {
+            run_job(&job);
+            continue;
+        }
+        if (atomic_load_u32(&system->stopping)) {
+            break;
+        }
+        // every submit posts, so a job pushed after find_job() missed it still wakes us
+        platform_semaphore_wait(system->wake);
+    }
+    current_worker = NULL;
+}
+
+u64 job_system_mem_size(u32 num_threads, u32 deque_capacity)
+{
+    if (num_threads == 0) {
+        num_threads = platform_num_cpus();
+    }
+    num_threads = MIN(num_threads, JOB_MAX_THREADS);
+    // one per worker, plus the external deque
+    return ((u64)num_threads + 1) * deque_capacity * sizeof(Job);
+}
+
+bool job_system_start(JobSystem *system, u32 num_threads, u32 deque_capacity,
+                      void *mem, u64 mem_size)
+{
+    ASSERT(system);
+    ASSERT(mem);
+    ASSERT(deque_capacity > 0);
+    ASSERT(mem_size >= job_system_mem_size(num_threads, deque_capacity));
+
+    if (num_threads == 0) {
+        num_threads = platform_num_cpus();
+    }
+    num_threads = MIN(num_threads, JOB_MAX_THREADS);
+
+    Job *jobs = (Job *)mem;
+    system->num_workers = 0;
+    system->stopping = 0;
+    deque_init(&system->external, jobs, deque_capacity);
+    jobs += deque_capacity;
+    system->wake = platform_semaphore_create(0);
+    CHECK_LOG(system->wake, false, "Failed to create job semaphore");
+
+    // set up every deque before any worker can go looking in them
+    for (u32 i = 0; i < num_threads; ++i) {
+        JobWorker *worker = &system->workers[i];
+        worker->system = system;
+        worker->index = i;
+        worker->steal_seed = 0x9E3779B9u * (i + 1);
+        worker->thread = NULL;
+        deque_init(&worker->deque, jobs, deque_capacity);
+        jobs += deque_capacity;
+    }
+    system->num_workers = num_threads;
+    for (u32 i = 0; i < num_threads; ++i) {
+        JobWorker *worker = &system->workers[i];
+        worker->thread = platform_thread_start(worker_main, worker);
+        if (!worker->thread) {
+            log_error("Failed to start job worker %u", i);
+            job_system_stop(system);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void job_system_stop(JobSystem *system)
+{
+    ASSERT(system);
+
+    atomic_store_u32(&system->stopping, 1);
+    platform_semaphore_post(system->wake, system->num_workers);
+    for (u32 i = 0; i < system->num_workers; ++i) {
+        if (system->workers[i].thread) {
+            platform_thread_join(system->workers[i].thread);
+            system->workers[i].thread = NULL;
+        }
+    }
+    // anything left (if workers failed to start) runs here
+    Job job;
+    while (find_job(system, &job)) {
+        run_job(&job);
+    }
+    system->num_workers = 0;
+    platform_semaphore_destroy(system->wake);
+    system->wake = NULL;
+}
+
+void job_submit(JobSystem *system, Job *jobs, u32 count, JobCounter *counter)
+{
+    ASSERT(system);
+    ASSERT(jobs || count == 0);
+
+    if (counter) {
+        atomic_fetch_add_u32(&counter->pending, count);
+    }
+    JobWorker *self = worker_in(system);
+    JobDeque *deque = self ? &self->deque : &system->external;
+    u32 queued = 0;
+    for (u32 i = 0; i < count; ++i) {
+        Job job = jobs[i];
+        ASSERT(job.fn);
+        job.counter = counter;
+        if (deque_push(deque, job)) {
+            queued++;
+        } else {
+            run_job(&job);
+        }
+    }
+    platform_semaphore_post(system->wake, MIN(queued, system->num_workers));
+}
+
+void job_wait(JobSystem *system, JobCounter *counter)
+{
+    ASSERT(system);
+    ASSERT(counter);
+
+    while (!job_counter_done(counter)) {
+        Job job;
+        if (find_job(system, &job)) {
+            run_job(&job);
+        } else {
+            platform_thread_yield();
+        }
+    }
+}
+
+bool job_counter_done(JobCounter *counter)
+{
+    ASSERT(counter);
+    return atomic_load_u32(&counter->pending) == 0;
+}
+
+C_END
@@ -1,5 +1,12 @@
 #include<stdlib.h>
 #include<unistd.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<time.h>
+#include<pthread.h>
+#include<sched.h>
+#include<semaphore.h>
 #include"types.h"
 #include"platform.h"
 #include"log.h"
@@ -11,6 +18,32 @@ void platform_console_print(const char *ptr, size_t len)
     write(1, ptr, len);
 }
 
+static u64 start_ms;
+
+u64 platform_ticks_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+u64 platform_cpu_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+static u64 monotonic_ms()
+{
+    return platform_ticks_ns() / 1000000;
+}
+
+u64 platform_ticks_ms()
+{
+    return monotonic_ms() - start_ms;
+}
+
 /* TODO maybe use memmap and madvise*/
 void *platform_alloc_page_aligned(size_t size)
 {
@@ -24,9 +57,128 @@ bool platform_free_page_aligned(void *ptr)
     return true;
 }
 
+void *platform_map_file(const char *path, u64 *size)
+{
+    ASSERT(path);
+    ASSERT(size);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (u64)st.st_size;
+    return ptr;
+}
+
+bool platform_unmap_file(void *ptr, u64 size)
+{
+    ASSERT(ptr);
+    return munmap(ptr, size) == 0;
+}
+
+struct PlatformThread {
+    pthread_t handle;
+    PlatformThreadFn fn;
+    void *data;
+};
+
+static void *thread_main(void *arg)
+{
+    PlatformThread *thread = (PlatformThread *)arg;
+    thread->fn(thread->data);
+    return NULL;
+}
+
+PlatformThread *platform_thread_start(PlatformThreadFn fn, void *data)
+{
+    ASSERT(fn);
+
+    PlatformThread *thread = malloc(sizeof(PlatformThread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->data = data;
+    if (pthread_create(&thread->handle, NULL, thread_main, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(PlatformThread *thread)
+{
+    ASSERT(thread);
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+u32 platform_num_cpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (u32)n : 1;
+}
+
+void platform_thread_yield()
+{
+    sched_yield();
+}
+
+struct PlatformSemaphore {
+    sem_t sem;
+};
+
+PlatformSemaphore *platform_semaphore_create(u32 count)
+{
+    PlatformSemaphore *sem = malloc(sizeof(PlatformSemaphore));
+    if (!sem) {
+        return NULL;
+    }
+    if (sem_init(&sem->sem, 0, count) != 0) {
+        free(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+void platform_semaphore_destroy(PlatformSemaphore *sem)
+{
+    ASSERT(sem);
+    sem_destroy(&sem->sem);
+    free(sem);
+}
+
+void platform_semaphore_wait(PlatformSemaphore *sem)
+{
+    ASSERT(sem);
+    // retry if a signal interrupts the wait
+    while (sem_wait(&sem->sem) != 0) {
+    }
+}
+
+void platform_semaphore_post(PlatformSemaphore *sem, u32 count)
+{
+    ASSERT(sem);
+    for (u32 i = 0; i < count; ++i) {
+        sem_post(&sem->sem);
+    }
+}
+
 bool platform_init()
 {
     ASSERT(sysconf(_SC_PAGE_SIZE) == PAGE_SIZE);
+    start_ms = monotonic_ms();
     return true;
 }
 
@@ -2,7 +2,6 @@
 #include<stdio.h>
 #include<stdarg.h>
 #include<ctype.h>
-#include<SDL.h>
 #include"platform.h"
 #include"log.h"
 
@@ -133,7 +132,7 @@ void log_timestamp(const char *fmt, ...)
 
     size_t remaining = LOG_BUF_SZ;
     *buf++ = '[';
-    size_t time_len = format_time_ms(SDL_GetTicks64(), buf, LOG_TIMESTAMP_SZ);
+    size_t time_len = format_time_ms(platform_ticks_ms(), buf, LOG_TIMESTAMP_SZ);
     ASSERT(time_len < LOG_BUF_SZ - 3);
     buf += time_len;
     *buf++ = ']';
@@ -194,7 +193,7 @@ bool log_init()
         return false;
     }
     // TODO
-    // raw because SDL isn't initted yet
+    // raw because nothing else is initted yet
 #ifdef DEBUG
     log_raw("Log init success\n");
 #endif
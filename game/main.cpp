@@ -1,3 +1,4 @@
+#include<string.h>
 #include<SDL.h>
 #include"glad/glad.h"
 #include"imgui.h"
@@ -95,6 +96,20 @@ u32 resize_window_to_game()
     return scale;
 }
 
+// queue a key press or release, if it changes the key's state
+static void queue_key(u64 time_ms, u8 button, bool *key_down, bool down)
+{
+    if (*key_down == down) {
+        return;
+    }
+    *key_down = down;
+    InputEvent event = {};
+    event.time_ms = time_ms;
+    event.button = button;
+    event.down = down;
+    input_queue_push(&game_state.input_queue, &event);
+}
+
 static void handle_event(SDL_Window* window, SDL_Event* e, ImGuiIO& imgui_io, Input *input)
 {
     bool button_down = false;
@@ -139,21 +154,45 @@ static void handle_event(SDL_Window* window, SDL_Event* e, ImGuiIO& imgui_io, In
             if (imgui_io.WantCaptureMouse) {
                 break;
             }
+            InputEvent event = {};
+            event.time_ms = e->button.timestamp;
+            event.mouse_x = (u32)e->button.x;
+            event.mouse_y = (u32)e->button.y;
+            event.down = button_down;
             switch(e->button.button)
             {
                 case SDL_BUTTON_LEFT:
                 {
-                    bool mouse_left_down = button_down;
+                    event.button = INPUT_BUTTON_LEFT;
+                    input_queue_push(&game_state.input_queue, &event);
                     break;
                 }
                 case SDL_BUTTON_RIGHT:
                 {
-                    bool mouse_right_down = button_down;
+                    event.button = INPUT_BUTTON_RIGHT;
+                    input_queue_push(&game_state.input_queue, &event);
                     break;
                 }
             }
             break;
         }
+        case SDL_MOUSEWHEEL:
+        {
+            if (imgui_io.WantCaptureMouse || e->wheel.y == 0) {
+                break;
+            }
+            int mouse_x, mouse_y;
+            SDL_GetMouseState(&mouse_x, &mouse_y);
+            InputEvent event = {};
+            event.time_ms = e->wheel.timestamp;
+            event.mouse_x = (u32)mouse_x;
+            event.mouse_y = (u32)mouse_y;
+            event.down = true;
+            bool zoom_in = (e->wheel.y > 0) != (e->wheel.direction == SDL_MOUSEWHEEL_FLIPPED);
+            event.button = zoom_in ? INPUT_BUTTON_ZOOM_IN : INPUT_BUTTON_ZOOM_OUT;
+            input_queue_push(&game_state.input_queue, &event);
+            break;
+        }
         case SDL_KEYDOWN:
         button_down = true;
         case SDL_KEYUP:
@@ -162,7 +201,17 @@ static void handle_event(SDL_Window* window, SDL_Event* e, ImGuiIO& imgui_io, In
                 break;
             }
             SDL_Keycode keycode = e->key.keysym.sym;
+            bool ctrl = e->key.keysym.mod & KMOD_CTRL;
+            bool shift = e->key.keysym.mod & KMOD_SHIFT;
+            u64 time_ms = e->key.timestamp;
             switch (keycode) {
+                case SDLK_z:
+                    queue_key(time_ms, INPUT_BUTTON_UNDO, &input->undo_key, button_down && ctrl && !shift);
+                    queue_key(time_ms, INPUT_BUTTON_REDO, &input->redo_key, button_down && ctrl && shift);
+                    break;
+                case SDLK_y:
+                    queue_key(time_ms, INPUT_BUTTON_REDO, &input->redo_key, button_down && ctrl);
+                    break;
 #ifdef DEBUG
                 case SDLK_BACKQUOTE:
                     input->debug_key = button_down;
@@ -182,6 +231,7 @@ static void poll_mouse(ImGuiIO& imgui_io, Input *input)
     if (imgui_io.WantCaptureMouse) {
         input->mouse_left_down = false;
         input->mouse_right_down = false;
+        input->mouse_middle_down = false;
         return;
     }
 
@@ -189,15 +239,27 @@ static void poll_mouse(ImGuiIO& imgui_io, Input *input)
 
     input->mouse_left_down = state & SDL_BUTTON_LMASK;
     input->mouse_right_down = state & SDL_BUTTON_RMASK;
+    input->mouse_middle_down = state & SDL_BUTTON_MMASK;
     input->mouse_x = (u32)window_pixel_x;
     input->mouse_y = (u32)window_pixel_y;
 }
 
+static void usage(const char *name)
+{
+    log_info("USAGE: %s [--record FILE] [--play FILE [--fast]]", name);
+    log_info("--record saves a replay of the session to FILE on exit");
+    log_info("--play plays back a replay in place of input, then exits");
+    log_info("--fast plays it back as fast as possible, without presenting frames");
+}
+
 int main(int argc, char **argv)
 {
     SDL_Window* window = NULL;
     SDL_GLContext gl_context = NULL;
     SDL_GameController* controller = NULL;
+    const char *record_path = NULL;
+    const char *play_path = NULL;
+    bool fast = false;
 
     if (!platform_init()) {
         return EXIT_FAILURE;
@@ -207,6 +269,23 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (!strcmp(argv[i], "--play") && i + 1 < argc) {
+            play_path = argv[++i];
+        } else if (!strcmp(argv[i], "--fast")) {
+            fast = true;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((record_path && play_path) || (fast && !play_path)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
     if (!mem_init(GiB(1))) {
         log_error("Failed to initialize memory subsystem");
         return EXIT_FAILURE;
@@ -285,6 +364,13 @@ int main(int argc, char **argv)
     }
     */
 
+    if (record_path && !game_replay_record(record_path)) {
+        return EXIT_FAILURE;
+    }
+    if (play_path && !game_replay_play(play_path, fast)) {
+        return EXIT_FAILURE;
+    }
+
     if (!game_init()) {
         log_error("Failed to initialize game");
         return EXIT_FAILURE;
@@ -293,8 +379,28 @@ int main(int argc, char **argv)
     SDL_SetRelativeMouseMode(SDL_FALSE);
 
     SDL_Event e;
+    u64 num_frames = 0;
+    u64 num_ticks = 0;
+    u64 start_ns = platform_ticks_ns();
+    // real time is banked here and spent in fixed ticks of game time
+    u64 prev_frame_ns = start_ns;
+    u64 accumulator_ns = 0;
+    u64 game_time_ns = 0;
+    u64 cpu_start_ns = platform_cpu_time_ns();
+    bool rendered = true;
+    u32 frames_since_event = 0;
 
     while(keep_running) {
+        // a replay's input doesn't come as events, so it can't wait for them
+        bool idle = game_state.idle_render && !play_path;
+        u64 waited_ns = 0;
+        // nothing changed last time round, so sleep until something might
+        if (idle && !rendered) {
+            u64 wait_start_ns = platform_ticks_ns();
+            SDL_WaitEventTimeout(NULL, (int)game_idle_wait_ms());
+            waited_ns = platform_ticks_ns() - wait_start_ns;
+        }
+
         /*
          * Note
          * starting the imgui frame before processing input seems to be the
@@ -308,15 +414,49 @@ int main(int argc, char **argv)
 
         static Input input = {}; // static so we can use same input again if imgui takes control
         bool imgui_used_event = false;
+        bool had_event = false;
         while (SDL_PollEvent(&e))
         {
             imgui_used_event = ImGui_ImplSDL2_ProcessEvent(&e);
             handle_event(window, &e, imgui_io, &input);
+            had_event = true;
         }
+        frames_since_event = had_event ? 0 : MIN(frames_since_event + 1, GAME_IDLE_SETTLE_FRAMES);
+        // the buttons' latest state, after any events queued above
         poll_mouse(imgui_io, &input);
+        input.real_time_ms = SDL_GetTicks64();
+
+        u64 now_ns = platform_ticks_ns();
+        // sleeping while idle isn't a stall, so all of it counts
+        accumulator_ns += MIN(now_ns - prev_frame_ns - waited_ns, GAME_MAX_FRAME_NS) + waited_ns;
+        prev_frame_ns = now_ns;
+        // fast playback doesn't wait for real time to pass
+        u64 num_frame_ticks = fast ? GAME_FAST_TICKS_PER_FRAME : accumulator_ns / GAME_TICK_NS;
+        if (!fast) {
+            accumulator_ns -= num_frame_ticks * GAME_TICK_NS;
+        }
+        // every tick this frame sees the same input, so it's only acted on once
+        for (u64 i = 0; i < num_frame_ticks && keep_running; ++i) {
+            input.time_ms = game_time_ns / 1000000;
+            if (!game_update(input)) {
+                keep_running = false;
+            }
+            game_time_ns += GAME_TICK_NS;
+            num_ticks++;
+        }
 
-        if (!game_update_and_render(input)) {
-            keep_running = false;
+        rendered = !idle || frames_since_event < GAME_IDLE_SETTLE_FRAMES || game_needs_render();
+        if (!rendered) {
+            ImGui::EndFrame();
+            continue;
+        }
+        game_render();
+        num_frames++;
+
+        if (fast) {
+            // nothing is shown, so there's no vsync to wait on
+            ImGui::EndFrame();
+            continue;
         }
 
         // Imgui boilerplate: end frame
@@ -328,6 +468,17 @@ int main(int argc, char **argv)
         SDL_GL_SwapWindow(window);
     }
 
+    f64 secs = (f64)(platform_ticks_ns() - start_ns) / 1e9;
+    f64 cpu_secs = (f64)(platform_cpu_time_ns() - cpu_start_ns) / 1e9;
+    if (play_path) {
+        log_info("Played %" PRIu64 " ticks (%" PRIu64 " frames) in %.3fs, %.1f ticks/s",
+                 num_ticks, num_frames, secs, secs > 0 ? (f64)num_ticks / secs : 0.0);
+    }
+    log_info("Drew %" PRIu64 " frames in %.1fs (%.1f/s), cpu %.1fs (%.1f%%)",
+             num_frames, secs, secs > 0 ? (f64)num_frames / secs : 0.0,
+             cpu_secs, secs > 0 ? 100.0 * cpu_secs / secs : 0.0);
+    game_replay_save();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
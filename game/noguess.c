@@ -0,0 +1,140 @@
+#include"types.h"
+#include"log.h"
+#include"atomic.h"
+#include"job.h"
+#include"rng.h"
+#include"engine.h"
+#include"solver.h"
+#include"noguess.h"
+
+C_BEGIN
+
+#define NOGUESS_ALIGN 16
+#define NOGUESS_ENGINE_FLAGS (ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK)
+
+// seed for candidate k; scrambled so neighbouring candidates aren't related
+static u64 candidate_seed(u64 base, u64 k)
+{
+    Rng rng;
+    rng_seed(&rng, base + k * 0x9E3779B97F4A7C15ULL);
+    u64 seed = rng_next(&rng);
+    // 0 would mean 'pick a seed' to the engine
+    return seed ? seed : 1;
+}
+
+static u64 worker_engine_mem_size(u32 width, u32 height)
+{
+    return ALIGN_UP_POW_2(engine_mem_size(width, height), NOGUESS_ALIGN);
+}
+
+static u64 worker_solver_mem_size(u32 width, u32 height)
+{
+    return ALIGN_UP_POW_2(solver_mem_size(width, height), NOGUESS_ALIGN);
+}
+
+static u64 worker_mem_size(u32 width, u32 height)
+{
+    return worker_engine_mem_size(width, height) + worker_solver_mem_size(width, height);
+}
+
+static void worker_main(void *data)
+{
+    NoGuessWorker *worker = (NoGuessWorker *)data;
+    NoGuessGen *gen = worker->gen;
+    GameParams params = gen->params;
+    u64 engine_mem_sz = worker_engine_mem_size(params.width, params.height);
+    u64 solver_mem_sz = worker_solver_mem_size(params.width, params.height);
+
+    while (!atomic_load_u32(&gen->cancelled)) {
+        u64 k = atomic_fetch_add_u64(&gen->next_candidate, 1);
+        // anything after a board we already have can't win
+        if (k >= gen->max_candidates || k > atomic_load_u64(&gen->found)) {
+            break;
+        }
+        params.seed = candidate_seed(gen->params.seed, k);
+        if (!engine_new_game(&worker->engine, params, worker->engine_mem, engine_mem_sz)) {
+            log_error("Failed to start candidate board");
+            break;
+        }
+        engine_reveal(&worker->engine, gen->first_c, gen->first_r, 0);
+        if (solver_play(&worker->solver, &worker->engine, worker->solver_mem, solver_mem_sz)) {
+            atomic_min_u64(&gen->found, k);
+        }
+    }
+}
+
+u64 noguess_mem_size(u32 width, u32 height, u32 num_workers)
+{
+    num_workers = CLAMP(num_workers, 1, NOGUESS_MAX_THREADS);
+    return worker_mem_size(width, height) * num_workers;
+}
+
+bool noguess_start(NoGuessGen *gen, JobSystem *jobs, GameParams params, u32 first_c, u32 first_r,
+                   u64 max_candidates, u32 num_workers, void *mem, u64 mem_size)
+{
+    ASSERT(gen);
+    ASSERT(jobs);
+    ASSERT(mem);
+    ASSERT(first_c < params.width);
+    ASSERT(first_r < params.height);
+    ASSERT(mem_size >= noguess_mem_size(params.width, params.height, num_workers));
+    ASSERT(ALIGN_UP_POW_2(mem, NOGUESS_ALIGN) == (u64)mem);
+
+    num_workers = CLAMP(num_workers, 1, NOGUESS_MAX_THREADS);
+
+    gen->jobs = jobs;
+    gen->params = params;
+    gen->first_c = first_c;
+    gen->first_r = first_r;
+    gen->max_candidates = max_candidates;
+    gen->next_candidate = 0;
+    gen->found = UINT64_MAX;
+    gen->cancelled = 0;
+    gen->counter.pending = 0;
+    gen->num_workers = num_workers;
+
+    Job worker_jobs[NOGUESS_MAX_THREADS];
+    u64 stride = worker_mem_size(params.width, params.height);
+    for (u32 i = 0; i < num_workers; ++i) {
+        NoGuessWorker *worker = &gen->workers[i];
+        worker->gen = gen;
+        worker->engine_mem = (u8 *)mem + stride * i;
+        worker->solver_mem = (u8 *)worker->engine_mem + worker_engine_mem_size(params.width, params.height);
+        engine_init(&worker->engine, params.seed, NOGUESS_ENGINE_FLAGS);
+        worker_jobs[i] = (Job){ worker_main, worker };
+    }
+    job_submit(jobs, worker_jobs, num_workers, &gen->counter);
+
+    return true;
+}
+
+bool noguess_done(NoGuessGen *gen)
+{
+    ASSERT(gen);
+    return job_counter_done(&gen->counter);
+}
+
+void noguess_cancel(NoGuessGen *gen)
+{
+    ASSERT(gen);
+    atomic_store_u32(&gen->cancelled, 1);
+}
+
+bool noguess_finish(NoGuessGen *gen, u64 *seed)
+{
+    ASSERT(gen);
+
+    job_wait(gen->jobs, &gen->counter);
+    gen->num_workers = 0;
+
+    u64 found = atomic_load_u64(&gen->found);
+    if (atomic_load_u32(&gen->cancelled) || found == UINT64_MAX) {
+        return false;
+    }
+    if (seed) {
+        *seed = candidate_seed(gen->params.seed, found);
+    }
+    return true;
+}
+
+C_END
@@ -0,0 +1,453 @@
+#include<math.h> // log, exp
+#include<string.h> // memset, memcpy
+
+#include"types.h"
+#include"log.h"
+#include"allocator.h"
+#include"engine.h"
+#include"prob.h"
+
+C_BEGIN
+
+#define PROB_ALIGN 16
+#define NO_FRONTIER UINT32_MAX
+
+// an explored number, over the frontier cells around it
+typedef struct {
+    u32 cells[8]; // frontier ids
+    u8 num_cells;
+    u8 need;
+} ProbConstraint;
+
+typedef struct {
+    u32 cell_idx; // board cell index
+    u32 cons[8]; // constraint ids
+    u8 num_cons;
+} ProbCell;
+
+typedef struct {
+    ProbCell *cells;
+    ProbConstraint *cons;
+    u8 *assign; // per frontier id, 1 for a bomb
+    i32 *need_left; // per constraint
+    i32 *free_left; // per constraint, cells not assigned yet
+    u32 *order; // frontier ids of the component, in assignment order
+    u32 n;
+    f64 *counts; // first pass: solutions per number of bombs in the component
+    f64 *weights; // second pass: weight of a solution per number of bombs
+    f64 *acc; // second pass: weighted solutions with each cell a bomb
+    u64 nodes;
+    u64 max_nodes;
+} Enumeration;
+
+static void *prob_alloc(BumpAllocator *arena, u64 size)
+{
+    return bump_alloc(arena, ALIGN_UP_POW_2(size, PROB_ALIGN));
+}
+
+u64 prob_mem_size(u32 width, u32 height)
+{
+    u64 num_cells = (u64)width * (u64)height;
+    u64 num_terms = num_cells + 1; // bomb counts 0..num_cells
+    return ALIGN_UP_POW_2(num_cells * sizeof(f32), PROB_ALIGN) +
+           ALIGN_UP_POW_2(num_cells * sizeof(ProbCell), PROB_ALIGN) +
+           ALIGN_UP_POW_2(num_cells * sizeof(ProbConstraint), PROB_ALIGN) +
+           ALIGN_UP_POW_2(num_cells * sizeof(u32), PROB_ALIGN) * 3 + // frontier_id, parent, order
+           ALIGN_UP_POW_2(num_terms * sizeof(u32), PROB_ALIGN) * 2 + // comp_start, suffix_len
+           ALIGN_UP_POW_2(num_cells, PROB_ALIGN) * 2 + // visited, assign
+           ALIGN_UP_POW_2(num_cells * sizeof(i32), PROB_ALIGN) * 2 + // need_left, free_left
+           ALIGN_UP_POW_2(num_cells * 2 * sizeof(f64), PROB_ALIGN) + // component polynomials
+           ALIGN_UP_POW_2(num_terms * sizeof(f64 *), PROB_ALIGN) +
+           ALIGN_UP_POW_2(num_terms * sizeof(f64), PROB_ALIGN) * 6 + // g, prefix, prefix_tmp, others, weights, acc
+           // suffix products of the component polynomials, one per component
+           num_terms * ALIGN_UP_POW_2(num_terms * sizeof(f64), PROB_ALIGN);
+}
+
+/* union-find over frontier ids */
+static u32 uf_find(u32 *parent, u32 x)
+{
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+static void uf_union(u32 *parent, u32 a, u32 b)
+{
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if (a != b) {
+        parent[MAX(a, b)] = MIN(a, b);
+    }
+}
+
+static void enumerate(Enumeration *e, u32 i, u32 bombs)
+{
+    if (e->max_nodes && e->nodes >= e->max_nodes) {
+        return;
+    }
+    e->nodes++;
+
+    if (i == e->n) {
+        if (!e->weights) {
+            e->counts[bombs] += 1;
+            return;
+        }
+        f64 weight = e->weights[bombs];
+        for (u32 j = 0; j < e->n; ++j) {
+            if (e->assign[e->order[j]]) {
+                e->acc[e->order[j]] += weight;
+            }
+        }
+        return;
+    }
+
+    u32 f = e->order[i];
+    ProbCell *cell = &e->cells[f];
+    for (i32 v = 0; v <= 1; ++v) {
+        // every number around the cell must still be satisfiable
+        bool ok = true;
+        for (u32 k = 0; k < cell->num_cons; ++k) {
+            u32 id = cell->cons[k];
+            i32 need = e->need_left[id] - v;
+            if (need < 0 || need > e->free_left[id] - 1) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) {
+            continue;
+        }
+        for (u32 k = 0; k < cell->num_cons; ++k) {
+            e->need_left[cell->cons[k]] -= v;
+            e->free_left[cell->cons[k]] -= 1;
+        }
+        e->assign[f] = (u8)v;
+        enumerate(e, i + 1, bombs + v);
+        for (u32 k = 0; k < cell->num_cons; ++k) {
+            e->need_left[cell->cons[k]] += v;
+            e->free_left[cell->cons[k]] += 1;
+        }
+    }
+    e->assign[f] = 0;
+}
+
+static void enumeration_reset(Enumeration *e, u32 num_cons)
+{
+    for (u32 i = 0; i < num_cons; ++i) {
+        e->need_left[i] = e->cons[i].need;
+        e->free_left[i] = e->cons[i].num_cells;
+    }
+}
+
+// out = a * b, where a has a_len terms and b has b_len
+static void poly_mul(const f64 *a, u32 a_len, const f64 *b, u32 b_len, f64 *out)
+{
+    memset(out, 0, (a_len + b_len - 1) * sizeof(f64));
+    for (u32 i = 0; i < a_len; ++i) {
+        if (a[i] == 0) {
+            continue;
+        }
+        for (u32 j = 0; j < b_len; ++j) {
+            out[i + j] += a[i] * b[j];
+        }
+    }
+}
+
+/*
+ * ln(n!), without lgamma(), which sets the global signgam and so isn't
+ * safe to call from several batch threads at once
+ * Small n are summed, the rest use Stirling's series (error < 1e-12)
+ */
+static f64 log_factorial(u64 n)
+{
+    if (n < 16) {
+        f64 x = 0;
+        for (u64 i = 2; i <= n; ++i) {
+            x += log((f64)i);
+        }
+        return x;
+    }
+    f64 x = (f64)n;
+    f64 inv = 1 / x;
+    f64 inv2 = inv * inv;
+    // 0.9189... is ln(2 pi) / 2
+    return x * log(x) - x + 0.5 * log(x) + 0.91893853320467274178 +
+           inv * (1.0 / 12 - inv2 * (1.0 / 360 - inv2 / 1260));
+}
+
+static f64 log_choose(u64 n, u64 k)
+{
+    return log_factorial(n) - log_factorial(k) - log_factorial(n - k);
+}
+
+bool prob_compute(Prob *prob, Board *board, void *mem, u64 mem_size, u64 max_nodes)
+{
+    ASSERT(prob);
+    ASSERT(board);
+    ASSERT(mem);
+
+    u64 num_cells = board->num_cells;
+    BumpAllocator arena;
+    bump_init_allocator(&arena, mem, mem_size);
+
+    memset(prob, 0, sizeof(*prob));
+    prob->bomb_prob = prob_alloc(&arena, num_cells * sizeof(f32));
+    u32 *frontier_id = prob_alloc(&arena, num_cells * sizeof(u32));
+    ProbCell *cells = prob_alloc(&arena, num_cells * sizeof(ProbCell));
+    ProbConstraint *cons = prob_alloc(&arena, num_cells * sizeof(ProbConstraint));
+    CHECK_LOG(prob->bomb_prob && frontier_id && cells && cons, false, "Out of prob memory");
+
+    /* constraints, numbering frontier cells as they're found */
+    for (u64 i = 0; i < num_cells; ++i) {
+        frontier_id[i] = NO_FRONTIER;
+    }
+    u32 num_frontier = 0;
+    u32 num_cons = 0;
+    u64 num_unexplored = 0;
+    for (u32 r = 0; r < board->height; ++r) {
+        for (u32 c = 0; c < board->width; ++c) {
+            Cell *cell = board_pos_to_cell(board, c, r);
+            if (cell->state != CELL_EXPLORED) {
+                num_unexplored++;
+                continue;
+            }
+            if (cell->bombs_around == 0) {
+                continue;
+            }
+            ProbConstraint *con = &cons[num_cons];
+            con->num_cells = 0;
+            con->need = cell->bombs_around;
+            for (i64 rr = (i64)r - 1; rr <= (i64)r + 1; ++rr) {
+                for (i64 cc = (i64)c - 1; cc <= (i64)c + 1; ++cc) {
+                    if (rr < 0 || rr >= board->height || cc < 0 || cc >= board->width) {
+                        continue;
+                    }
+                    u64 idx = (u64)rr * board->width + (u64)cc;
+                    if (board_idx_to_cell(board, idx)->state == CELL_EXPLORED) {
+                        continue;
+                    }
+                    if (frontier_id[idx] == NO_FRONTIER) {
+                        frontier_id[idx] = num_frontier;
+                        cells[num_frontier].cell_idx = (u32)idx;
+                        cells[num_frontier].num_cons = 0;
+                        num_frontier++;
+                    }
+                    u32 f = frontier_id[idx];
+                    con->cells[con->num_cells++] = f;
+                    cells[f].cons[cells[f].num_cons++] = num_cons;
+                }
+            }
+            if (con->num_cells > 0) {
+                num_cons++;
+            }
+        }
+    }
+    prob->num_frontier = num_frontier;
+
+    /* split into components */
+    u32 *parent = prob_alloc(&arena, num_cells * sizeof(u32));
+    u32 *order = prob_alloc(&arena, num_cells * sizeof(u32));
+    u32 *comp_start = prob_alloc(&arena, (num_cells + 1) * sizeof(u32));
+    u8 *visited = prob_alloc(&arena, num_cells);
+    CHECK_LOG(parent && order && comp_start && visited, false, "Out of prob memory");
+    for (u32 f = 0; f < num_frontier; ++f) {
+        parent[f] = f;
+    }
+    for (u32 i = 0; i < num_cons; ++i) {
+        for (u32 k = 1; k < cons[i].num_cells; ++k) {
+            uf_union(parent, cons[i].cells[0], cons[i].cells[k]);
+        }
+    }
+    /*
+     * Order each component breadth first through its numbers, so cells
+     * that share numbers get assigned close together and bad branches
+     * get cut early
+     */
+    u32 num_comps = 0;
+    u32 num_ordered = 0;
+    memset(visited, 0, num_frontier);
+    for (u32 root = 0; root < num_frontier; ++root) {
+        if (uf_find(parent, root) != root) {
+            continue;
+        }
+        comp_start[num_comps] = num_ordered;
+        u32 head = num_ordered;
+        order[num_ordered++] = root;
+        visited[root] = 1;
+        while (head < num_ordered) {
+            ProbCell *cell = &cells[order[head++]];
+            for (u32 k = 0; k < cell->num_cons; ++k) {
+                ProbConstraint *con = &cons[cell->cons[k]];
+                for (u32 j = 0; j < con->num_cells; ++j) {
+                    if (!visited[con->cells[j]]) {
+                        visited[con->cells[j]] = 1;
+                        order[num_ordered++] = con->cells[j];
+                    }
+                }
+            }
+        }
+        prob->largest_component = MAX(prob->largest_component, num_ordered - comp_start[num_comps]);
+        num_comps++;
+    }
+    comp_start[num_comps] = num_ordered;
+    ASSERT(num_ordered == num_frontier);
+    prob->num_components = num_comps;
+
+    /* first pass: count each component's solutions by number of bombs */
+    Enumeration e = {0};
+    e.cells = cells;
+    e.cons = cons;
+    e.assign = prob_alloc(&arena, num_cells);
+    e.need_left = prob_alloc(&arena, num_cells * sizeof(i32));
+    e.free_left = prob_alloc(&arena, num_cells * sizeof(i32));
+    // component j's polynomial starts at poly[comp_start[j] + j], and has size + 1 terms
+    f64 *poly = prob_alloc(&arena, (num_frontier + num_comps) * sizeof(f64));
+    CHECK_LOG(e.assign && e.need_left && e.free_left && poly, false, "Out of prob memory");
+    memset(e.assign, 0, num_frontier);
+    memset(poly, 0, (num_frontier + num_comps) * sizeof(f64));
+    e.max_nodes = max_nodes;
+    enumeration_reset(&e, num_cons);
+
+    for (u32 j = 0; j < num_comps; ++j) {
+        e.order = &order[comp_start[j]];
+        e.n = comp_start[j + 1] - comp_start[j];
+        e.counts = &poly[comp_start[j] + j];
+        enumerate(&e, 0, 0);
+    }
+    if (max_nodes && e.nodes >= max_nodes) {
+        prob->num_nodes = e.nodes;
+        return false;
+    }
+
+    /*
+     * G[t]: ways to put the other bombs off the frontier when t are on it,
+     * C(off, bombs - t), scaled down by the largest so it fits in an f64
+     */
+    u64 num_off = num_unexplored - num_frontier;
+    u64 num_bombs = board->num_bombs;
+    f64 *g = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    CHECK_LOG(g, false, "Out of prob memory");
+    f64 log_max = -INFINITY;
+    for (u32 t = 0; t <= num_frontier; ++t) {
+        if (t <= num_bombs && num_bombs - t <= num_off) {
+            log_max = MAX(log_max, log_choose(num_off, num_bombs - t));
+        }
+    }
+    for (u32 t = 0; t <= num_frontier; ++t) {
+        g[t] = 0;
+        if (t <= num_bombs && num_bombs - t <= num_off) {
+            g[t] = exp(log_choose(num_off, num_bombs - t) - log_max);
+        }
+    }
+
+    /* suffix[j] = product of the polynomials of components j.. */
+    f64 **suffix = prob_alloc(&arena, (num_comps + 1) * sizeof(f64 *));
+    u32 *suffix_len = prob_alloc(&arena, (num_comps + 1) * sizeof(u32));
+    CHECK_LOG(suffix && suffix_len, false, "Out of prob memory");
+    suffix_len[num_comps] = 1;
+    suffix[num_comps] = prob_alloc(&arena, sizeof(f64));
+    CHECK_LOG(suffix[num_comps], false, "Out of prob memory");
+    suffix[num_comps][0] = 1;
+    for (i64 j = (i64)num_comps - 1; j >= 0; --j) {
+        u32 len = comp_start[j + 1] - comp_start[j] + 1;
+        suffix_len[j] = suffix_len[j + 1] + len - 1;
+        suffix[j] = prob_alloc(&arena, suffix_len[j] * sizeof(f64));
+        if (!suffix[j]) {
+            log_error("Out of prob memory for %u components", num_comps);
+            return false;
+        }
+        poly_mul(&poly[comp_start[j] + j], len, suffix[j + 1], suffix_len[j + 1], suffix[j]);
+    }
+
+    /* Z, and the expected number of bombs off the frontier */
+    f64 total = 0;
+    f64 off_bombs = 0;
+    for (u32 t = 0; t < suffix_len[0]; ++t) {
+        total += suffix[0][t] * g[t];
+        off_bombs += suffix[0][t] * g[t] * (f64)(num_bombs - MIN(t, num_bombs));
+    }
+    if (total <= 0) {
+        log_error("No arrangement of bombs fits the board");
+        return false;
+    }
+
+    /*
+     * Second pass: weight each solution of component j by how many ways
+     * the other components and the cells off the frontier can go with it
+     */
+    f64 *prefix = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    f64 *prefix_tmp = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    f64 *others = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    e.weights = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    e.acc = prob_alloc(&arena, (num_frontier + 1) * sizeof(f64));
+    CHECK_LOG(prefix && prefix_tmp && others && e.weights && e.acc, false, "Out of prob memory");
+    memset(e.acc, 0, num_frontier * sizeof(f64));
+    // it walks the same tree as the first pass, so it gets its own budget
+    u64 first_pass_nodes = e.nodes;
+    e.nodes = 0;
+    prefix[0] = 1;
+    u32 prefix_len = 1;
+    for (u32 j = 0; j < num_comps; ++j) {
+        u32 len = comp_start[j + 1] - comp_start[j] + 1;
+        f64 *comp_poly = &poly[comp_start[j] + j];
+        poly_mul(prefix, prefix_len, suffix[j + 1], suffix_len[j + 1], others);
+        u32 others_len = prefix_len + suffix_len[j + 1] - 1;
+        for (u32 k = 0; k < len; ++k) {
+            f64 w = 0;
+            for (u32 t = 0; t < others_len && k + t <= num_frontier; ++t) {
+                w += others[t] * g[k + t];
+            }
+            e.weights[k] = w / total;
+        }
+        e.order = &order[comp_start[j]];
+        e.n = len - 1;
+        enumerate(&e, 0, 0);
+
+        poly_mul(prefix, prefix_len, comp_poly, len, prefix_tmp);
+        prefix_len += len - 1;
+        memcpy(prefix, prefix_tmp, prefix_len * sizeof(f64));
+    }
+    prob->num_nodes = first_pass_nodes + e.nodes;
+    // a cut off pass would leave e.acc partly summed
+    if (max_nodes && e.nodes >= max_nodes) {
+        return false;
+    }
+
+    f32 off_prob = num_off ? (f32)(off_bombs / total / (f64)num_off) : 0;
+    for (u64 i = 0; i < num_cells; ++i) {
+        if (board_idx_to_cell(board, i)->state == CELL_EXPLORED) {
+            prob->bomb_prob[i] = 0;
+        } else if (frontier_id[i] == NO_FRONTIER) {
+            prob->bomb_prob[i] = off_prob;
+        } else {
+            prob->bomb_prob[i] = (f32)e.acc[frontier_id[i]];
+        }
+    }
+
+    return true;
+}
+
+bool prob_safest(Prob *prob, Board *board, u32 *c, u32 *r)
+{
+    ASSERT(prob);
+    ASSERT(board);
+    ASSERT(c);
+    ASSERT(r);
+
+    bool found = false;
+    f32 best = 2;
+    for (u64 i = 0; i < board->num_cells; ++i) {
+        if (board_idx_to_cell(board, i)->state != CELL_UNEXPLORED || prob->bomb_prob[i] >= best) {
+            continue;
+        }
+        best = prob->bomb_prob[i];
+        *c = (u32)(i % board->width);
+        *r = (u32)(i / board->width);
+        found = true;
+    }
+    return found;
+}
+
+C_END
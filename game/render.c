@@ -40,6 +40,9 @@ static GLint gl_viewport_y = 0;
 static GLsizei gl_viewport_width = 0;
 static GLsizei gl_viewport_height = 0;
 static f32 viewport_aspect = 0;
+// size of the pixel space shader_set_transform_pixels() last set up
+static f32 transform_width = 0;
+static f32 transform_height = 0;
 
 void shader_set_color(GLuint shader_id, Color color)
 {
@@ -107,6 +110,8 @@ static void shader_set_transform(GLuint shader_id,
 void shader_set_transform_pixels(GLuint shader_id, f32 width, f32 height)
 {
     log_debug("Resizing ortho transform (%f, %f)", width, height);
+    transform_width = width;
+    transform_height = height;
     // we want the origin to be in the top left
     Mat4 proj_matrix = mat4_ortho(0, width,  // left at 0, right at pixel width
                                   height, 0, // bottom at height, top at 0, so y=0 == height, y=height == 0
@@ -119,6 +124,33 @@ void shader_set_transform_pixels(GLuint shader_id, f32 width, f32 height)
                          &model_matrix);
 }
 
+void shader_set_view(GLuint shader_id, const Mat4 *view)
+{
+    glUseProgram(shader_id);
+    GLint loc = glGetUniformLocation(shader_id, "view");
+    glUniformMatrix4fv(loc, 1, GL_FALSE, view->data);
+    dump_errors();
+}
+
+void render_clip_pixels(f32 x, f32 y, f32 width, f32 height)
+{
+    ASSERT(transform_width > 0 && transform_height > 0);
+    // the screen texture is the size of the gl viewport, and its y is up
+    f32 scale_x = (f32)gl_viewport_width / transform_width;
+    f32 scale_y = (f32)gl_viewport_height / transform_height;
+    glScissor((GLint)(x * scale_x),
+              (GLint)((f32)gl_viewport_height - (y + height) * scale_y),
+              (GLsizei)(width * scale_x),
+              (GLsizei)(height * scale_y));
+    glEnable(GL_SCISSOR_TEST);
+    dump_errors();
+}
+
+void render_clip_none()
+{
+    glDisable(GL_SCISSOR_TEST);
+}
+
 // TODO split into load and create
 static GLuint load_shader(const char *filename, unsigned type)
 {
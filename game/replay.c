@@ -0,0 +1,250 @@
+#include<string.h>
+
+#include"types.h"
+#include"log.h"
+#include"replay.h"
+
+C_BEGIN
+
+#define REPLAY_MAGIC_LEN 4
+// a varint of a u64 is at most 10 bytes, and an event is at most 5 of them (a game start's time + 4 params) + the header
+#define REPLAY_MAX_EVENT_SIZE (1 + 5 * 10)
+
+/* LEB128: 7 bits a byte, low bits first, top bit set if more follow */
+static u8 *put_varint(u8 *p, u64 x)
+{
+    while (x >= 0x80) {
+        *p++ = (u8)(x | 0x80);
+        x >>= 7;
+    }
+    *p++ = (u8)x;
+    return p;
+}
+
+static bool get_varint(Replay *replay, u64 *x)
+{
+    u64 result = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        CHECK(replay->pos < replay->len, false);
+        u8 byte = replay->data[replay->pos++];
+        result |= (u64)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *x = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_varint_u32(Replay *replay, u32 *x)
+{
+    u64 x64;
+    CHECK(get_varint(replay, &x64), false);
+    CHECK(x64 <= UINT32_MAX, false);
+    *x = (u32)x64;
+    return true;
+}
+
+// floats go in as their bits
+static u32 f32_bits(f32 x)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static f32 bits_f32(u32 bits)
+{
+    f32 x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// zigzag, so small negative mouse deltas are small varints too
+static u64 zigzag(i64 x)
+{
+    return ((u64)x << 1) ^ (u64)(x >> 63);
+}
+
+static i64 unzigzag(u64 x)
+{
+    return (i64)(x >> 1) ^ -(i64)(x & 1);
+}
+
+void replay_init_writer(Replay *replay, void *mem, u64 mem_size)
+{
+    ASSERT(replay);
+    ASSERT(mem);
+
+    memset(replay, 0, sizeof(*replay));
+    replay->data = (u8 *)mem;
+    replay->capacity = mem_size;
+    if (mem_size < REPLAY_MAGIC_LEN + 1) {
+        replay->full = true;
+        return;
+    }
+    memcpy(replay->data, REPLAY_MAGIC, REPLAY_MAGIC_LEN);
+    replay->data[REPLAY_MAGIC_LEN] = REPLAY_VERSION;
+    replay->len = REPLAY_MAGIC_LEN + 1;
+}
+
+bool replay_init_reader(Replay *replay, const void *data, u64 len)
+{
+    ASSERT(replay);
+    ASSERT(data || len == 0);
+
+    memset(replay, 0, sizeof(*replay));
+    replay->data = (u8 *)data;
+    replay->len = len;
+    replay->capacity = len;
+    CHECK_LOG(len >= REPLAY_MAGIC_LEN + 1 && !memcmp(data, REPLAY_MAGIC, REPLAY_MAGIC_LEN),
+              false, "Not a replay file");
+    CHECK_LOG(replay->data[REPLAY_MAGIC_LEN] == REPLAY_VERSION, false,
+              "Unsupported replay version %u", replay->data[REPLAY_MAGIC_LEN]);
+    replay->pos = REPLAY_MAGIC_LEN + 1;
+    return true;
+}
+
+void replay_write(Replay *replay, const ReplayEvent *event)
+{
+    ASSERT(replay);
+    ASSERT(event);
+    ASSERT(event->time_ms >= replay->time_ms);
+
+    if (replay->full) {
+        return;
+    }
+    if (replay->capacity - replay->len < REPLAY_MAX_EVENT_SIZE) {
+        log_error("Replay buffer full, no more events will be recorded");
+        replay->full = true;
+        return;
+    }
+
+    u8 *p = &replay->data[replay->len];
+    u8 *header = p++;
+    *header = event->type;
+    p = put_varint(p, event->time_ms - replay->time_ms);
+    replay->time_ms = event->time_ms;
+
+    switch (event->type) {
+        case REPLAY_EVENT_INPUT:
+        {
+            ASSERT(event->buttons < 16);
+            *header |= (u8)(event->buttons << 4);
+            if (event->mouse_x != replay->mouse_x || event->mouse_y != replay->mouse_y) {
+                *header |= REPLAY_HEADER_FLAG;
+                p = put_varint(p, zigzag((i64)event->mouse_x - (i64)replay->mouse_x));
+                p = put_varint(p, zigzag((i64)event->mouse_y - (i64)replay->mouse_y));
+                replay->mouse_x = event->mouse_x;
+                replay->mouse_y = event->mouse_y;
+            }
+            replay->buttons = event->buttons;
+            break;
+        }
+        case REPLAY_EVENT_GAME_START:
+        {
+            if (event->no_guess) {
+                *header |= REPLAY_HEADER_FLAG;
+            }
+            p = put_varint(p, event->params.width);
+            p = put_varint(p, event->params.height);
+            p = put_varint(p, event->params.num_bombs);
+            p = put_varint(p, event->params.seed);
+            break;
+        }
+        case REPLAY_EVENT_BOARD:
+        {
+            p = put_varint(p, event->seed);
+            break;
+        }
+        case REPLAY_EVENT_CAMERA:
+        {
+            p = put_varint(p, f32_bits(event->camera_x));
+            p = put_varint(p, f32_bits(event->camera_y));
+            p = put_varint(p, f32_bits(event->camera_zoom));
+            break;
+        }
+        default:
+            ASSERT(false);
+            break;
+    }
+    replay->len = (u64)(p - replay->data);
+    ASSERT(replay->len <= replay->capacity);
+}
+
+bool replay_read(Replay *replay, ReplayEvent *event)
+{
+    ASSERT(replay);
+    ASSERT(event);
+
+    CHECK(replay->pos < replay->len, false);
+
+    memset(event, 0, sizeof(*event));
+    u8 header = replay->data[replay->pos++];
+    u64 dt_ms;
+    CHECK_LOG(get_varint(replay, &dt_ms), false, "Truncated replay");
+    event->type = header & 0x3;
+    event->time_ms = replay->time_ms + dt_ms;
+    replay->time_ms = event->time_ms;
+
+    switch (event->type) {
+        case REPLAY_EVENT_INPUT:
+        {
+            event->buttons = header >> 4;
+            if (header & REPLAY_HEADER_FLAG) {
+                u64 dx, dy;
+                CHECK_LOG(get_varint(replay, &dx) && get_varint(replay, &dy), false,
+                          "Truncated replay");
+                replay->mouse_x = (u32)((i64)replay->mouse_x + unzigzag(dx));
+                replay->mouse_y = (u32)((i64)replay->mouse_y + unzigzag(dy));
+            }
+            event->mouse_x = replay->mouse_x;
+            event->mouse_y = replay->mouse_y;
+            replay->buttons = event->buttons;
+            break;
+        }
+        case REPLAY_EVENT_GAME_START:
+        {
+            event->no_guess = header & REPLAY_HEADER_FLAG;
+            CHECK_LOG(get_varint_u32(replay, &event->params.width) &&
+                      get_varint_u32(replay, &event->params.height) &&
+                      get_varint_u32(replay, &event->params.num_bombs) &&
+                      get_varint(replay, &event->params.seed),
+                      false, "Truncated replay");
+            break;
+        }
+        case REPLAY_EVENT_BOARD:
+        {
+            CHECK_LOG(get_varint(replay, &event->seed), false, "Truncated replay");
+            break;
+        }
+        case REPLAY_EVENT_CAMERA:
+        {
+            u32 x, y, zoom;
+            CHECK_LOG(get_varint_u32(replay, &x) &&
+                      get_varint_u32(replay, &y) &&
+                      get_varint_u32(replay, &zoom),
+                      false, "Truncated replay");
+            event->camera_x = bits_f32(x);
+            event->camera_y = bits_f32(y);
+            event->camera_zoom = bits_f32(zoom);
+            break;
+        }
+        default:
+            log_error("Unknown replay event %u", event->type);
+            return false;
+    }
+    return true;
+}
+
+bool replay_peek(Replay *replay, ReplayEvent *event)
+{
+    ASSERT(replay);
+
+    Replay saved = *replay;
+    bool ok = replay_read(replay, event);
+    *replay = saved;
+    return ok;
+}
+
+C_END
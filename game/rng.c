@@ -0,0 +1,114 @@
+#include"types.h"
+#include"rng.h"
+
+#ifdef _MSC_VER
+#include<intrin.h>
+#endif
+
+C_BEGIN
+
+static u64 splitmix64(u64 *state)
+{
+    u64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static u64 rotl(u64 x, u32 k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// full 128 bit product of a and b
+static u64 mul_u64(u64 a, u64 b, u64 *hi)
+{
+#ifdef _MSC_VER
+    return _umul128(a, b, hi);
+#else
+    __uint128_t m = (__uint128_t)a * b;
+    *hi = (u64)(m >> 64);
+    return (u64)m;
+#endif
+}
+
+void rng_seed(Rng *rng, u64 seed)
+{
+    ASSERT(rng);
+
+    for (u32 i = 0; i < ARRAY_LEN(rng->s); ++i) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+u64 rng_next(Rng *rng)
+{
+    ASSERT(rng);
+
+    u64 *s = rng->s;
+    u64 ret = rotl(s[1] * 5, 7) * 9;
+    u64 t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return ret;
+}
+
+void rng_jump(Rng *rng)
+{
+    ASSERT(rng);
+
+    static const u64 jump[] = {
+        0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+        0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+    };
+    u64 s[4] = {0};
+    for (u32 i = 0; i < ARRAY_LEN(jump); ++i) {
+        for (u32 b = 0; b < 64; ++b) {
+            if (jump[i] & (1ULL << b)) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+    for (u32 i = 0; i < ARRAY_LEN(s); ++i) {
+        rng->s[i] = s[i];
+    }
+}
+
+/*
+ * Lemire's multiply-and-shift: the high word of x * bound is in [0, bound)
+ * Only low words below 2^64 % bound are biased, so reject those
+ * The % only happens in the rare case the low word is small
+ */
+u64 rng_below(Rng *rng, u64 bound)
+{
+    ASSERT(rng);
+    ASSERT(bound > 0);
+
+    u64 hi;
+    u64 lo = mul_u64(rng_next(rng), bound, &hi);
+    if (lo < bound) {
+        u64 threshold = (0 - bound) % bound;
+        while (lo < threshold) {
+            lo = mul_u64(rng_next(rng), bound, &hi);
+        }
+    }
+    return hi;
+}
+
+f64 rng_f64(Rng *rng)
+{
+    // top 53 bits fill the mantissa exactly
+    return (f64)(rng_next(rng) >> 11) * (1.0 / (f64)(1ULL << 53));
+}
+
+C_END
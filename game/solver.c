@@ -0,0 +1,291 @@
+#include<string.h> // memset
+
+#include"types.h"
+#include"allocator.h"
+#include"engine.h"
+#include"solver.h"
+
+C_BEGIN
+
+#define SOLVER_ALIGN 16
+
+/*
+ * Unknown cells around a constraint as a bit mask over the 7x7 window
+ * centred on the cell being checked, so overlapping constraints (up to
+ * 2 cells away) can be compared with a few and/popcount ops
+ */
+#define WINDOW_SIZE 7
+#define WINDOW_BIT(dc, dr) (1ULL << (((dr) + 3) * WINDOW_SIZE + ((dc) + 3)))
+
+static void *solver_alloc(BumpAllocator *arena, u64 size)
+{
+    return bump_alloc(arena, ALIGN_UP_POW_2(size, SOLVER_ALIGN));
+}
+
+u64 solver_mem_size(u32 width, u32 height)
+{
+    u64 num_cells = (u64)width * (u64)height;
+    return ALIGN_UP_POW_2(num_cells, SOLVER_ALIGN) * 2 +
+           ALIGN_UP_POW_2(num_cells * sizeof(u32), SOLVER_ALIGN) * 3;
+}
+
+static bool is_number(Cell *cell)
+{
+    return cell->state == CELL_EXPLORED && cell->bombs_around > 0;
+}
+
+static void enqueue(Solver *solver, u64 idx)
+{
+    if (solver->queued[idx]) {
+        return;
+    }
+    Board *board = solver->board;
+    ASSERT(solver->queue_len < board->num_cells);
+    solver->queue[(solver->queue_head + solver->queue_len) % board->num_cells] = (u32)idx;
+    solver->queue_len++;
+    solver->queued[idx] = 1;
+}
+
+// queue the numbers in the 3x3 square around c, r (including c, r)
+static void enqueue_around(Solver *solver, u32 c, u32 r)
+{
+    Board *board = solver->board;
+    u32 r0 = r > 0 ? r - 1 : 0;
+    u32 r1 = MIN(r + 1, board->height - 1);
+    u32 c0 = c > 0 ? c - 1 : 0;
+    u32 c1 = MIN(c + 1, board->width - 1);
+    for (u32 rr = r0; rr <= r1; ++rr) {
+        for (u32 cc = c0; cc <= c1; ++cc) {
+            if (is_number(board_pos_to_cell(board, cc, rr))) {
+                enqueue(solver, (u64)rr * board->width + cc);
+            }
+        }
+    }
+}
+
+static void mark(Solver *solver, u32 c, u32 r, u8 known)
+{
+    Board *board = solver->board;
+    u64 idx = (u64)r * board->width + c;
+    if (solver->known[idx] != SOLVER_UNKNOWN) {
+        ASSERT(solver->known[idx] == known);
+        return;
+    }
+    ASSERT(board_idx_to_cell(board, idx)->is_bomb == (known == SOLVER_BOMB));
+    solver->known[idx] = known;
+    if (known == SOLVER_SAFE) {
+        solver->safe[solver->num_safe++] = (u32)idx;
+    } else {
+        solver->bombs[solver->num_bombs++] = (u32)idx;
+    }
+    // every constraint this cell was in just changed
+    enqueue_around(solver, c, r);
+}
+
+/*
+ * The constraint of the number at c, r, in the window centred on
+ * centre_c, centre_r: the mask of its unknown neighbours and how many
+ * of them are bombs
+ */
+static u64 constraint(Solver *solver, u32 c, u32 r, u32 centre_c, u32 centre_r, i32 *need)
+{
+    Board *board = solver->board;
+    Cell *cell = board_pos_to_cell(board, c, r);
+    u64 mask = 0;
+    i32 bombs = cell->bombs_around;
+    for (i64 rr = (i64)r - 1; rr <= (i64)r + 1; ++rr) {
+        if (rr < 0 || rr >= board->height) {
+            continue;
+        }
+        for (i64 cc = (i64)c - 1; cc <= (i64)c + 1; ++cc) {
+            if (cc < 0 || cc >= board->width) {
+                continue;
+            }
+            u64 idx = (u64)rr * board->width + (u64)cc;
+            if (board_idx_to_cell(board, idx)->state == CELL_EXPLORED) {
+                continue;
+            }
+            if (solver->known[idx] == SOLVER_BOMB) {
+                bombs--;
+            } else if (solver->known[idx] == SOLVER_UNKNOWN) {
+                mask |= WINDOW_BIT(cc - (i64)centre_c, rr - (i64)centre_r);
+            }
+        }
+    }
+    *need = bombs;
+    return mask;
+}
+
+// mark every cell in a window mask centred on c, r
+static void mark_mask(Solver *solver, u32 c, u32 r, u64 mask, u8 known)
+{
+    while (mask) {
+        u32 bit = CTZ_U64(mask);
+        i64 dc = (i64)(bit % WINDOW_SIZE) - 3;
+        i64 dr = (i64)(bit / WINDOW_SIZE) - 3;
+        mark(solver, (u32)(c + dc), (u32)(r + dr), known);
+        mask &= mask - 1;
+    }
+}
+
+static void check_constraint(Solver *solver, u32 c, u32 r)
+{
+    Board *board = solver->board;
+    solver->num_checks++;
+
+    i32 need;
+    u64 mask = constraint(solver, c, r, c, r, &need);
+    if (!mask) {
+        return;
+    }
+    u32 num_unknown = POPCOUNT_U64(mask);
+    ASSERT(need >= 0 && (u32)need <= num_unknown);
+
+    /* on its own */
+    if (need == 0) {
+        mark_mask(solver, c, r, mask, SOLVER_SAFE);
+        return;
+    }
+    if ((u32)need == num_unknown) {
+        mark_mask(solver, c, r, mask, SOLVER_BOMB);
+        return;
+    }
+
+    /*
+     * Against each overlapping constraint y
+     * Split into only_x, shared and only_y; shared holds at most
+     * min(need, need_y) bombs, so:
+     * if need - need_y == |only_x|, only_x is all bombs and only_y all safe
+     * (which covers y being a subset of x, where only_y is empty)
+     */
+    u32 r0 = r >= 2 ? r - 2 : 0;
+    u32 r1 = MIN(r + 2, board->height - 1);
+    u32 c0 = c >= 2 ? c - 2 : 0;
+    u32 c1 = MIN(c + 2, board->width - 1);
+    for (u32 yr = r0; yr <= r1; ++yr) {
+        for (u32 yc = c0; yc <= c1; ++yc) {
+            if ((yc == c && yr == r) || !is_number(board_pos_to_cell(board, yc, yr))) {
+                continue;
+            }
+            i32 need_y;
+            u64 mask_y = constraint(solver, yc, yr, c, r, &need_y);
+            if (!(mask & mask_y)) {
+                continue;
+            }
+            u64 only_x = mask & ~mask_y;
+            u64 only_y = mask_y & ~mask;
+            if (need - need_y == (i32)POPCOUNT_U64(only_x)) {
+                mark_mask(solver, c, r, only_x, SOLVER_BOMB);
+                mark_mask(solver, c, r, only_y, SOLVER_SAFE);
+            } else if (need_y - need == (i32)POPCOUNT_U64(only_y)) {
+                mark_mask(solver, c, r, only_y, SOLVER_BOMB);
+                mark_mask(solver, c, r, only_x, SOLVER_SAFE);
+            }
+        }
+    }
+}
+
+void solver_init(Solver *solver, Board *board, void *mem, u64 mem_size)
+{
+    ASSERT(solver);
+    ASSERT(board);
+    ASSERT(mem);
+    ASSERT(mem_size >= solver_mem_size(board->width, board->height));
+
+    BumpAllocator arena;
+    bump_init_allocator(&arena, mem, mem_size);
+
+    u64 num_cells = board->num_cells;
+    memset(solver, 0, sizeof(*solver));
+    solver->board = board;
+    solver->known = solver_alloc(&arena, num_cells);
+    solver->queued = solver_alloc(&arena, num_cells);
+    solver->queue = solver_alloc(&arena, num_cells * sizeof(u32));
+    solver->safe = solver_alloc(&arena, num_cells * sizeof(u32));
+    solver->bombs = solver_alloc(&arena, num_cells * sizeof(u32));
+    memset(solver->known, 0, num_cells);
+    memset(solver->queued, 0, num_cells);
+
+    for (u32 r = 0; r < board->height; ++r) {
+        for (u32 c = 0; c < board->width; ++c) {
+            if (is_number(board_pos_to_cell(board, c, r))) {
+                enqueue(solver, (u64)r * board->width + c);
+            }
+        }
+    }
+}
+
+u64 solver_deduce(Solver *solver)
+{
+    ASSERT(solver);
+
+    Board *board = solver->board;
+    u64 num_found = solver->num_safe + solver->num_bombs;
+    while (solver->queue_len) {
+        u64 idx = solver->queue[solver->queue_head];
+        solver->queue_head = (solver->queue_head + 1) % board->num_cells;
+        solver->queue_len--;
+        solver->queued[idx] = 0;
+        check_constraint(solver, (u32)(idx % board->width), (u32)(idx / board->width));
+    }
+    return solver->num_safe + solver->num_bombs - num_found;
+}
+
+void solver_on_reveal(void *data, u32 r, u32 c0, u32 c1)
+{
+    Solver *solver = (Solver *)data;
+    ASSERT(solver);
+
+    /*
+     * New numbers are new constraints, and numbers next to the span lost
+     * unknown cells; the span grown by 1 all round covers both
+     */
+    Board *board = solver->board;
+    u32 r0 = r > 0 ? r - 1 : 0;
+    u32 r1 = MIN(r + 1, board->height - 1);
+    c0 = c0 > 0 ? c0 - 1 : 0;
+    c1 = MIN(c1 + 1, board->width - 1);
+    for (u32 rr = r0; rr <= r1; ++rr) {
+        for (u32 c = c0; c <= c1; ++c) {
+            if (is_number(board_pos_to_cell(board, c, rr))) {
+                enqueue(solver, (u64)rr * board->width + c);
+            }
+        }
+    }
+}
+
+bool solver_play(Solver *solver, Engine *engine, void *mem, u64 mem_size)
+{
+    ASSERT(solver);
+    ASSERT(engine);
+
+    Board *board = &engine->board;
+    EngineSpanFn span_fn = engine->span_fn;
+    void *span_data = engine->span_data;
+
+    solver_init(solver, board, mem, mem_size);
+    engine->span_fn = solver_on_reveal;
+    engine->span_data = solver;
+
+    u64 revealed = 0;
+    u64 flagged = 0;
+    while (engine->status == ENGINE_PLAYING && solver_deduce(solver) > 0) {
+        for (; revealed < solver->num_safe; ++revealed) {
+            u32 idx = solver->safe[revealed];
+            // may already be explored by another safe cell's flood fill
+            engine_reveal(engine, idx % board->width, idx / board->width, engine->time_ms);
+        }
+        for (; flagged < solver->num_bombs; ++flagged) {
+            u32 idx = solver->bombs[flagged];
+            if (board_idx_to_cell(board, idx)->state == CELL_UNEXPLORED) {
+                engine_toggle_flag(engine, idx % board->width, idx / board->width);
+            }
+        }
+    }
+
+    engine->span_fn = span_fn;
+    engine->span_data = span_data;
+    return engine->status == ENGINE_WON;
+}
+
+C_END
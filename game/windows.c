@@ -1,5 +1,6 @@
 #include<windows.h>
 #include<stdio.h>
+#include<stdlib.h>
 #include"types.h"
 #include"platform.h"
 #include"log.h"
@@ -12,6 +13,39 @@ void platform_console_print(const char *ptr, size_t len)
     printf(ptr);
 }
 
+static u64 start_ms;
+
+u64 platform_ticks_ms()
+{
+    return GetTickCount64() - start_ms;
+}
+
+u64 platform_ticks_ns()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    // split to avoid overflowing the multiply
+    u64 secs = now.QuadPart / freq.QuadPart;
+    u64 rem = now.QuadPart % freq.QuadPart;
+    return secs * 1000000000 + (rem * 1000000000) / freq.QuadPart;
+}
+
+u64 platform_cpu_time_ns()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    // FILETIMEs count 100ns intervals
+    u64 kernel_100ns = ((u64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    u64 user_100ns = ((u64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (kernel_100ns + user_100ns) * 100;
+}
+
 void *platform_alloc_page_aligned(size_t size)
 {
     return VirtualAlloc(NULL, ALIGN_UP_POW_2(size, PAGE_SIZE), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
@@ -23,8 +57,135 @@ bool platform_free_page_aligned(void *ptr)
     return VirtualFree(ptr, 0, MEM_RELEASE);
 }
 
+void *platform_map_file(const char *path, u64 *size)
+{
+    ASSERT(path);
+    ASSERT(size);
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return NULL;
+    }
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    // the view keeps the mapping (and file) open
+    CloseHandle(mapping);
+    if (!ptr) {
+        return NULL;
+    }
+    *size = (u64)file_size.QuadPart;
+    return ptr;
+}
+
+bool platform_unmap_file(void *ptr, u64 size)
+{
+    ASSERT(ptr);
+    return UnmapViewOfFile(ptr);
+}
+
+struct PlatformThread {
+    HANDLE handle;
+    PlatformThreadFn fn;
+    void *data;
+};
+
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    PlatformThread *thread = (PlatformThread *)arg;
+    thread->fn(thread->data);
+    return 0;
+}
+
+PlatformThread *platform_thread_start(PlatformThreadFn fn, void *data)
+{
+    ASSERT(fn);
+
+    PlatformThread *thread = malloc(sizeof(PlatformThread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->data = data;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(PlatformThread *thread)
+{
+    ASSERT(thread);
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+u32 platform_num_cpus()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (u32)info.dwNumberOfProcessors : 1;
+}
+
+void platform_thread_yield()
+{
+    SwitchToThread();
+}
+
+struct PlatformSemaphore {
+    HANDLE handle;
+};
+
+PlatformSemaphore *platform_semaphore_create(u32 count)
+{
+    PlatformSemaphore *sem = malloc(sizeof(PlatformSemaphore));
+    if (!sem) {
+        return NULL;
+    }
+    sem->handle = CreateSemaphoreA(NULL, (LONG)count, MAXLONG, NULL);
+    if (!sem->handle) {
+        free(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+void platform_semaphore_destroy(PlatformSemaphore *sem)
+{
+    ASSERT(sem);
+    CloseHandle(sem->handle);
+    free(sem);
+}
+
+void platform_semaphore_wait(PlatformSemaphore *sem)
+{
+    ASSERT(sem);
+    WaitForSingleObject(sem->handle, INFINITE);
+}
+
+void platform_semaphore_post(PlatformSemaphore *sem, u32 count)
+{
+    ASSERT(sem);
+    if (count > 0) {
+        ReleaseSemaphore(sem->handle, (LONG)count, NULL);
+    }
+}
+
 bool platform_init()
 {
+    start_ms = GetTickCount64();
     return true;
 }
 
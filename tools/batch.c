@@ -0,0 +1,435 @@
+/*
+ * Headless batch runner: plays lots of games per board config on every
+ * cpu, with the solver deducing what it can and guessing the safest cell
+ * (see prob.h) when it gets stuck
+ * Usage: batch [-n games] [-t threads] [-s seed] [-f csv|json] [config...]
+ * config is easy, medium, hard or WxHxB; defaults to the first three
+ * Results go to stdout as csv (default) or a json array
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"types.h"
+#include"platform.h"
+#include"log.h"
+#include"mem.h"
+#include"allocator.h"
+#include"engine.h"
+#include"rng.h"
+#include"job.h"
+#include"solver.h"
+#include"prob.h"
+
+#define BATCH_MEM_BUDGET GiB(4ULL)
+#define BATCH_DEFAULT_GAMES 10000
+#define BATCH_DEFAULT_SEED 0x2545F4914F6CDD1DULL
+#define BATCH_MAX_THREADS JOB_MAX_THREADS
+#define BATCH_MAX_CONFIGS 32
+#define BATCH_ALIGN 16
+/*
+ * prob_mem_size() is quadratic in cells, so bigger boards guess a
+ * random unexplored cell instead
+ */
+#define BATCH_PROB_MAX_CELLS 2048
+// backtracking budget per guess; over it, guess a random cell instead
+#define BATCH_PROB_MAX_NODES 1000000
+
+typedef struct {
+    char name[32];
+    GameParams params;
+} BatchConfig;
+
+typedef struct {
+    u64 games;
+    u64 won;
+    u64 over_budget; // guesses where prob_compute() hit BATCH_PROB_MAX_NODES
+    u64 guesses;
+    u64 total_3bv;
+    u64 ns_new_game; // engine_new_game() and the first reveal
+    u64 ns_solve; // solver_play()
+    u64 ns_guess; // prob_compute() and picking a cell
+} BatchResult;
+
+typedef struct {
+    const BatchConfig *config;
+    Rng rng; // this thread's stream; game seeds come from here
+    u64 games;
+    void *mem;
+    u64 mem_size;
+    BatchResult result;
+} BatchWorker;
+
+static bool use_prob(GameParams params)
+{
+    return (u64)params.width * params.height <= BATCH_PROB_MAX_CELLS;
+}
+
+static u64 worker_mem_size(GameParams params)
+{
+    u64 num_cells = (u64)params.width * params.height;
+    u64 size = ALIGN_UP_POW_2(engine_mem_size(params.width, params.height), BATCH_ALIGN) +
+               ALIGN_UP_POW_2(solver_mem_size(params.width, params.height), BATCH_ALIGN) +
+               // 3BV scratch: visited flags and a fill stack
+               ALIGN_UP_POW_2(num_cells, BATCH_ALIGN) +
+               ALIGN_UP_POW_2(num_cells * sizeof(u32), BATCH_ALIGN);
+    if (use_prob(params)) {
+        size += ALIGN_UP_POW_2(prob_mem_size(params.width, params.height), BATCH_ALIGN);
+    }
+    return size;
+}
+
+static void *worker_alloc(BumpAllocator *arena, u64 size)
+{
+    return bump_alloc(arena, ALIGN_UP_POW_2(size, BATCH_ALIGN));
+}
+
+static bool is_opening(Cell *cell)
+{
+    return !cell->is_bomb && cell->bombs_around == 0;
+}
+
+/*
+ * Bechtel's Board Benchmark Value: the fewest clicks that clear the
+ * board, i.e. one per opening plus one per safe cell not next to any
+ */
+static u64 board_3bv(Board *board, u8 *visited, u32 *stack)
+{
+    memset(visited, 0, board->num_cells);
+    u64 count = 0;
+    for (u64 start = 0; start < board->num_cells; ++start) {
+        if (visited[start] || !is_opening(board_idx_to_cell(board, start))) {
+            continue;
+        }
+        count++;
+        u64 len = 0;
+        stack[len++] = (u32)start;
+        visited[start] = 1;
+        while (len > 0) {
+            i64 c, r;
+            board_idx_to_pos(board, stack[--len], &c, &r);
+            for (i64 rr = r - 1; rr <= r + 1; ++rr) {
+                for (i64 cc = c - 1; cc <= c + 1; ++cc) {
+                    if (rr < 0 || rr >= board->height || cc < 0 || cc >= board->width) {
+                        continue;
+                    }
+                    u64 idx = (u64)rr * board->width + (u64)cc;
+                    if (visited[idx]) {
+                        continue;
+                    }
+                    // numbers on the edge of the opening are cleared with it
+                    visited[idx] = 1;
+                    if (is_opening(board_idx_to_cell(board, idx))) {
+                        stack[len++] = (u32)idx;
+                    }
+                }
+            }
+        }
+    }
+    for (u64 i = 0; i < board->num_cells; ++i) {
+        count += !visited[i] && !board_idx_to_cell(board, i)->is_bomb;
+    }
+    return count;
+}
+
+// random unexplored cell, for boards too big for prob_compute()
+static bool random_unexplored(Board *board, Rng *rng, u32 *c, u32 *r)
+{
+    u64 num_unexplored = 0;
+    for (u64 i = 0; i < board->num_cells; ++i) {
+        num_unexplored += board_idx_to_cell(board, i)->state == CELL_UNEXPLORED;
+    }
+    if (num_unexplored == 0) {
+        return false;
+    }
+    u64 k = rng_below(rng, num_unexplored);
+    for (u64 i = 0; i < board->num_cells; ++i) {
+        if (board_idx_to_cell(board, i)->state != CELL_UNEXPLORED) {
+            continue;
+        }
+        if (k-- == 0) {
+            *c = (u32)(i % board->width);
+            *r = (u32)(i / board->width);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void worker_main(void *data)
+{
+    BatchWorker *worker = (BatchWorker *)data;
+    GameParams params = worker->config->params;
+    u64 num_cells = (u64)params.width * params.height;
+    bool guess_prob = use_prob(params);
+    BatchResult *result = &worker->result;
+
+    BumpAllocator arena;
+    bump_init_allocator(&arena, worker->mem, worker->mem_size);
+    u64 engine_mem_sz = engine_mem_size(params.width, params.height);
+    u64 solver_mem_sz = solver_mem_size(params.width, params.height);
+    u64 prob_mem_sz = guess_prob ? prob_mem_size(params.width, params.height) : 0;
+    void *engine_mem = worker_alloc(&arena, engine_mem_sz);
+    void *solver_mem = worker_alloc(&arena, solver_mem_sz);
+    u8 *visited = worker_alloc(&arena, num_cells);
+    u32 *stack = worker_alloc(&arena, num_cells * sizeof(u32));
+    void *prob_mem = guess_prob ? worker_alloc(&arena, prob_mem_sz) : NULL;
+    ASSERT(engine_mem && solver_mem && visited && stack && (prob_mem || !guess_prob));
+
+    Engine engine;
+    Solver solver;
+    Prob prob;
+    engine_init(&engine, rng_next(&worker->rng), ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+    for (u64 g = 0; g < worker->games; ++g) {
+        // 0 would ask the engine to pick
+        params.seed = rng_next(&worker->rng) | 1;
+        u64 start = platform_ticks_ns();
+        if (!engine_new_game(&engine, params, engine_mem, engine_mem_sz)) {
+            log_error("Failed to start game %llu", (unsigned long long)g);
+            return;
+        }
+        engine_reveal(&engine, params.width / 2, params.height / 2, 0);
+        u64 now = platform_ticks_ns();
+        result->ns_new_game += now - start;
+        result->games++;
+        result->total_3bv += board_3bv(&engine.board, visited, stack);
+
+        while (true) {
+            start = platform_ticks_ns();
+            bool won = solver_play(&solver, &engine, solver_mem, solver_mem_sz);
+            now = platform_ticks_ns();
+            result->ns_solve += now - start;
+            if (won || engine.status != ENGINE_PLAYING) {
+                break;
+            }
+
+            start = now;
+            u32 c, r;
+            bool found;
+            if (guess_prob &&
+                prob_compute(&prob, &engine.board, prob_mem, prob_mem_sz, BATCH_PROB_MAX_NODES)) {
+                found = prob_safest(&prob, &engine.board, &c, &r);
+            } else {
+                result->over_budget += guess_prob;
+                found = random_unexplored(&engine.board, &worker->rng, &c, &r);
+            }
+            result->ns_guess += platform_ticks_ns() - start;
+            if (!found) {
+                break;
+            }
+            result->guesses++;
+            engine_reveal(&engine, c, r, 0);
+        }
+        result->won += engine.status == ENGINE_WON;
+    }
+}
+
+static bool parse_config(const char *str, BatchConfig *config)
+{
+    static const BatchConfig presets[] = {
+        { "easy", game_easy },
+        { "medium", game_medium },
+        { "hard", game_hard },
+    };
+    for (u32 i = 0; i < ARRAY_LEN(presets); ++i) {
+        if (strcmp(str, presets[i].name) == 0) {
+            *config = presets[i];
+            return true;
+        }
+    }
+
+    unsigned w, h, b;
+    char end;
+    if (sscanf(str, "%ux%ux%u%c", &w, &h, &b, &end) != 3) {
+        log_error("Bad config \"%s\", expected easy, medium, hard or WxHxB", str);
+        return false;
+    }
+    u64 num_cells = (u64)w * h;
+    // at least one cell has to be free of bombs, for the first click
+    CHECK_LOG(w > 0 && h > 0 && num_cells <= ENGINE_MAX_CELLS && b < num_cells, false,
+              "Bad board %ux%u with %u bombs", w, h, b);
+    snprintf(config->name, sizeof(config->name), "%ux%ux%u", w, h, b);
+    config->params = (GameParams){ .width = w, .height = h, .num_bombs = b, .seed = 0 };
+    return true;
+}
+
+/*
+ * Play games of config split evenly into one job per job system thread
+ * Each worker's rng is the previous one's jumped ahead, so the streams
+ * never overlap and results only depend on seed and thread count
+ */
+static bool run_config(JobSystem *jobs, const BatchConfig *config, u64 games, u64 seed,
+                       BatchResult *result, u64 *wall_ns)
+{
+    static BatchWorker workers[BATCH_MAX_THREADS];
+    static Job worker_jobs[BATCH_MAX_THREADS];
+    u32 num_threads = jobs->num_workers;
+    u64 mem_size = ALIGN_UP_POW_2(worker_mem_size(config->params), PAGE_SIZE);
+
+    mem_ctx_t ctx;
+    MEM_SCRATCH_START(ctx);
+    u8 *mem = mem_alloc_aligned(PAGE_SIZE, mem_size * num_threads);
+    if (!mem) {
+        log_error("Failed to alloc %llu bytes for %s", (unsigned long long)(mem_size * num_threads),
+                  config->name);
+        MEM_SCRATCH_END(ctx);
+        return false;
+    }
+
+    Rng rng;
+    rng_seed(&rng, seed);
+    u64 start = platform_ticks_ns();
+    for (u32 i = 0; i < num_threads; ++i) {
+        BatchWorker *worker = &workers[i];
+        memset(worker, 0, sizeof(*worker));
+        worker->config = config;
+        worker->rng = rng;
+        rng_jump(&rng);
+        worker->games = games / num_threads + (i < games % num_threads);
+        worker->mem = &mem[mem_size * i];
+        worker->mem_size = mem_size;
+        worker_jobs[i] = (Job){ worker_main, worker };
+    }
+    JobCounter counter = {0};
+    job_submit(jobs, worker_jobs, num_threads, &counter);
+    job_wait(jobs, &counter);
+
+    memset(result, 0, sizeof(*result));
+    for (u32 i = 0; i < num_threads; ++i) {
+        BatchWorker *worker = &workers[i];
+        result->games += worker->result.games;
+        result->won += worker->result.won;
+        result->over_budget += worker->result.over_budget;
+        result->guesses += worker->result.guesses;
+        result->total_3bv += worker->result.total_3bv;
+        result->ns_new_game += worker->result.ns_new_game;
+        result->ns_solve += worker->result.ns_solve;
+        result->ns_guess += worker->result.ns_guess;
+    }
+    *wall_ns = platform_ticks_ns() - start;
+
+    MEM_SCRATCH_END(ctx);
+    return result->games == games;
+}
+
+static void print_result(const BatchConfig *config, const BatchResult *result, u64 wall_ns,
+                         bool json, bool first)
+{
+    GameParams params = config->params;
+    f64 games = (f64)MAX(result->games, 1);
+    f64 win_rate = result->won / games;
+    f64 avg_3bv = result->total_3bv / games;
+    f64 games_per_s = result->games / ((f64)wall_ns / 1e9);
+    // per game, summed over all threads
+    f64 us_new_game = result->ns_new_game / games / 1e3;
+    f64 us_solve = result->ns_solve / games / 1e3;
+    f64 us_guess = result->ns_guess / games / 1e3;
+
+    if (json) {
+        log_raw("%s  {\"config\": \"%s\", \"width\": %u, \"height\": %u, \"bombs\": %u, "
+                "\"games\": %llu, \"won\": %llu, \"over_budget\": %llu, \"win_rate\": %.6f, "
+                "\"avg_3bv\": %.3f, \"guesses_per_game\": %.3f, \"games_per_s\": %.1f, "
+                "\"new_game_us\": %.3f, \"solve_us\": %.3f, \"guess_us\": %.3f}",
+                first ? "" : ",\n", config->name, params.width, params.height, params.num_bombs,
+                (unsigned long long)result->games, (unsigned long long)result->won,
+                (unsigned long long)result->over_budget, win_rate, avg_3bv,
+                result->guesses / games, games_per_s, us_new_game, us_solve, us_guess);
+        return;
+    }
+    if (first) {
+        log_raw("config,width,height,bombs,games,won,over_budget,win_rate,avg_3bv,guesses_per_game,"
+                "games_per_s,new_game_us,solve_us,guess_us\n");
+    }
+    log_raw("%s,%u,%u,%u,%llu,%llu,%llu,%.6f,%.3f,%.3f,%.1f,%.3f,%.3f,%.3f\n",
+            config->name, params.width, params.height, params.num_bombs,
+            (unsigned long long)result->games, (unsigned long long)result->won,
+            (unsigned long long)result->over_budget, win_rate, avg_3bv, result->guesses / games,
+            games_per_s, us_new_game, us_solve, us_guess);
+}
+
+static void usage()
+{
+    log_raw("Usage: batch [-n games] [-t threads] [-s seed] [-f csv|json] [config...]\n"
+            "config is easy, medium, hard or WxHxB (default: easy medium hard)\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (!platform_init() || !log_init()) {
+        return 1;
+    }
+    if (!mem_init(BATCH_MEM_BUDGET)) {
+        log_error("Failed to initialize memory subsystem");
+        return 1;
+    }
+
+    static BatchConfig configs[BATCH_MAX_CONFIGS];
+    u32 num_configs = 0;
+    u64 games = BATCH_DEFAULT_GAMES;
+    u32 num_threads = platform_num_cpus();
+    u64 seed = BATCH_DEFAULT_SEED;
+    bool json = false;
+
+    for (int a = 1; a < argc; ++a) {
+        const char *arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (strcmp(arg, "-n") == 0 && has_value) {
+            games = strtoull(argv[++a], NULL, 0);
+        } else if (strcmp(arg, "-t") == 0 && has_value) {
+            num_threads = (u32)strtoul(argv[++a], NULL, 0);
+        } else if (strcmp(arg, "-s") == 0 && has_value) {
+            seed = strtoull(argv[++a], NULL, 0);
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            json = strcmp(argv[++a], "json") == 0;
+        } else if (arg[0] == '-') {
+            usage();
+            return 1;
+        } else {
+            if (num_configs == BATCH_MAX_CONFIGS) {
+                log_error("Too many configs, max %u", BATCH_MAX_CONFIGS);
+                return 1;
+            }
+            if (!parse_config(arg, &configs[num_configs])) {
+                return 1;
+            }
+            num_configs++;
+        }
+    }
+    if (num_configs == 0) {
+        parse_config("easy", &configs[num_configs++]);
+        parse_config("medium", &configs[num_configs++]);
+        parse_config("hard", &configs[num_configs++]);
+    }
+    num_threads = CLAMP(num_threads, 1, BATCH_MAX_THREADS);
+
+    static JobSystem jobs;
+    u64 jobs_mem_sz = job_system_mem_size(num_threads, num_threads);
+    void *jobs_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(jobs_mem_sz, 16));
+    if (!jobs_mem || !job_system_start(&jobs, num_threads, num_threads, jobs_mem, jobs_mem_sz)) {
+        log_error("Failed to start %u batch threads", num_threads);
+        return 1;
+    }
+
+    bool ok = true;
+    bool first = true;
+    if (json) {
+        log_raw("[\n");
+    }
+    for (u32 i = 0; i < num_configs; ++i) {
+        BatchResult result;
+        u64 wall_ns = 0;
+        if (!run_config(&jobs, &configs[i], games, seed, &result, &wall_ns)) {
+            log_error("Batch \"%s\" failed", configs[i].name);
+            ok = false;
+            continue;
+        }
+        print_result(&configs[i], &result, wall_ns, json, first);
+        first = false;
+    }
+    if (json) {
+        log_raw("\n]\n");
+    }
+    job_system_stop(&jobs);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,785 @@
+/*
+ * Headless benchmarks for the board engine
+ * No SDL or GL; links against the engine sources only
+ * Usage: bench [name...]
+ * Runs every benchmark if no names are given
+ */
+#include<stdio.h>
+#include<string.h>
+
+#include"types.h"
+#include"atomic.h"
+#include"platform.h"
+#include"log.h"
+#include"mem.h"
+#include"engine.h"
+#include"bitboard.h"
+#include"boxsum.h"
+#include"rng.h"
+#include"job.h"
+#include"noguess.h"
+#include"prob.h"
+#include"solver.h"
+
+#define BENCH_MEM_BUDGET GiB(1)
+#define BENCH_SEED 0x2545F4914F6CDD1DULL
+
+typedef struct {
+    const char *name;
+    bool (*fn)();
+} Bench;
+
+/* xorshift64*, just for making test boards */
+static Rng bench_rng;
+
+// keep results alive so the compiler can't drop the work
+static volatile u64 bench_sink;
+
+static f64 ns_per(u64 ns, u64 n)
+{
+    return (f64)ns / (f64)n;
+}
+
+/*
+ * The per-bomb neighbour loop board_init used before the whole-board
+ * passes, kept here as the baseline
+ */
+static void count_incremental(Cell *cells, u32 width, u32 height, const u32 *bomb_idxs, u32 num_bombs)
+{
+    memset(cells, 0, (u64)width * height * sizeof(Cell));
+    for (u32 i = 0; i < num_bombs; ++i) {
+        u32 idx = bomb_idxs[i];
+        i64 bomb_c = idx % width;
+        i64 bomb_r = idx / width;
+        cells[idx].is_bomb = true;
+        for (i64 r = bomb_r - 1; r <= bomb_r + 1; ++r) {
+            if (r < 0 || r >= height) {
+                continue;
+            }
+            for (i64 c = bomb_c - 1; c <= bomb_c + 1; ++c) {
+                if (c < 0 || c >= width) {
+                    continue;
+                }
+                Cell *neighbor = &cells[r * width + c];
+                if (neighbor->is_bomb) {
+                    neighbor->bombs_around = 0;
+                    continue;
+                }
+                neighbor->bombs_around++;
+            }
+        }
+    }
+}
+
+/*
+ * The same loop on a grid with a one cell border, like Board's, so the
+ * neighbours are fixed offsets with no bounds checks
+ * grid is (width + 2) * (height + 2) cells
+ */
+static void count_padded(Cell *grid, u32 width, u32 height, const u32 *bomb_idxs, u32 num_bombs)
+{
+    i64 stride = (i64)width + 2;
+    const i64 neighbours[8] = {
+        -stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1
+    };
+    memset(grid, 0, (u64)stride * (height + 2) * sizeof(Cell));
+    Cell *cells = grid + stride + 1;
+    for (u32 i = 0; i < num_bombs; ++i) {
+        u32 idx = bomb_idxs[i];
+        Cell *bomb = &cells[(idx / width) * stride + idx % width];
+        bomb->is_bomb = true;
+        bomb->bombs_around = 0;
+        for (u32 n = 0; n < ARRAY_LEN(neighbours); ++n) {
+            Cell *neighbor = bomb + neighbours[n];
+            neighbor->bombs_around += !neighbor->is_bomb;
+        }
+    }
+}
+
+static bool bench_counts()
+{
+    static const struct {
+        u32 width;
+        u32 height;
+        u32 num_bombs;
+        u32 iters;
+    } sizes[] = {
+        { 30, 16, 99, 20000 },
+        { 256, 256, 13000, 400 },
+        { 1024, 1024, 200000, 20 },
+        { 4096, 4096, 3200000, 2 },
+    };
+
+    log_raw("counts: bombs_around for a whole board (ns/cell)\n");
+    log_raw("%-12s %10s %10s %10s %10s %10s %10s\n",
+            "size", "loop", "padded", "scalar", "sse2", "avx2", "bitplane");
+
+    for (u32 s = 0; s < ARRAY_LEN(sizes); ++s) {
+        u32 width = sizes[s].width;
+        u32 height = sizes[s].height;
+        u32 num_bombs = sizes[s].num_bombs;
+        u32 iters = sizes[s].iters;
+        u64 num_cells = (u64)width * height;
+
+        mem_ctx_t ctx;
+        MEM_SCRATCH_START(ctx);
+
+        Cell *cells = mem_alloc(num_cells * sizeof(Cell));
+        Cell *grid = mem_alloc(((u64)width + 2) * (height + 2) * sizeof(Cell));
+        u32 *bomb_idxs = mem_alloc(num_bombs * sizeof(u32));
+        u8 *mask = mem_calloc(boxsum_mask_size(width, height), 1);
+        u8 *counts = mem_alloc(num_cells);
+        u8 *bit_counts = mem_alloc(num_cells);
+        void *bits_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(bitboard_mem_size(width, height), 16));
+        if (!cells || !grid || !bomb_idxs || !mask || !counts || !bit_counts || !bits_mem) {
+            log_error("Failed to alloc bench boards");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+        BitBoard bits;
+        bitboard_init(&bits, width, height, bits_mem);
+
+        // random distinct bombs
+        u32 placed = 0;
+        while (placed < num_bombs) {
+            u32 idx = (u32)rng_below(&bench_rng, num_cells);
+            u8 *m = boxsum_mask_cell(mask, width, idx % width, idx / width);
+            if (*m) {
+                continue;
+            }
+            *m = 1;
+            bitboard_set(&bits, BITPLANE_BOMB, idx % width, idx / width, true);
+            bomb_idxs[placed++] = idx;
+        }
+
+        f64 results[3 + BOXSUM_NUM_KERNELS];
+        for (u32 i = 0; i < ARRAY_LEN(results); ++i) {
+            results[i] = -1;
+        }
+
+        u64 start = platform_ticks_ns();
+        for (u32 i = 0; i < iters; ++i) {
+            count_incremental(cells, width, height, bomb_idxs, num_bombs);
+            bench_sink += cells[i % num_cells].bombs_around;
+        }
+        results[0] = ns_per(platform_ticks_ns() - start, iters * num_cells);
+
+        start = platform_ticks_ns();
+        for (u32 i = 0; i < iters; ++i) {
+            count_padded(grid, width, height, bomb_idxs, num_bombs);
+            bench_sink += grid[i % num_cells].bombs_around;
+        }
+        results[1] = ns_per(platform_ticks_ns() - start, iters * num_cells);
+        for (u64 i = 0; i < num_cells; ++i) {
+            Cell *cell = &grid[(i / width + 1) * (width + 2) + i % width + 1];
+            if (cell->bombs_around != cells[i].bombs_around || cell->is_bomb != cells[i].is_bomb) {
+                log_error("padded loop disagrees with the loop at cell %lu", i);
+                MEM_SCRATCH_END(ctx);
+                return false;
+            }
+        }
+
+        for (u32 k = 0; k <= boxsum_best_kernel(); ++k) {
+            start = platform_ticks_ns();
+            for (u32 i = 0; i < iters; ++i) {
+                boxsum_count(k, mask, width, height, counts);
+                bench_sink += counts[i % num_cells];
+            }
+            results[2 + k] = ns_per(platform_ticks_ns() - start, iters * num_cells);
+            for (u64 i = 0; i < num_cells; ++i) {
+                if (counts[i] != cells[i].bombs_around) {
+                    log_error("%s kernel disagrees with the loop at cell %lu", boxsum_kernel_name(k), i);
+                    MEM_SCRATCH_END(ctx);
+                    return false;
+                }
+            }
+        }
+
+        start = platform_ticks_ns();
+        for (u32 i = 0; i < iters; ++i) {
+            bitboard_count_neighbours(&bits, bit_counts);
+            bench_sink += bit_counts[i % num_cells];
+        }
+        results[2 + BOXSUM_NUM_KERNELS] = ns_per(platform_ticks_ns() - start, iters * num_cells);
+        if (memcmp(bit_counts, counts, num_cells) != 0) {
+            log_error("bitplane counts disagree with the loop");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+
+        char size_str[32];
+        snprintf(size_str, sizeof(size_str), "%ux%u", width, height);
+        log_raw("%-12s", size_str);
+        for (u32 i = 0; i < ARRAY_LEN(results); ++i) {
+            if (results[i] < 0) {
+                log_raw(" %10s", "n/a");
+            } else {
+                log_raw(" %10.3f", results[i]);
+            }
+        }
+        log_raw("\n");
+
+        MEM_SCRATCH_END(ctx);
+    }
+
+    return true;
+}
+
+static void count_span(void *data, u32 r, u32 c0, u32 c1)
+{
+    *(u64 *)data += 1;
+}
+
+/*
+ * One reveal on a board with few bombs, so it opens most of the board
+ * Times the flood fill plus the win check
+ */
+static bool bench_opening()
+{
+    static const struct {
+        u32 width;
+        u32 height;
+        u32 num_bombs;
+        u32 games;
+    } sizes[] = {
+        { 30, 16, 10, 20000 },
+        { 256, 256, 200, 200 },
+        { 1024, 1024, 1000, 10 },
+    };
+
+    log_raw("opening: one big reveal (ns/revealed cell)\n");
+    log_raw("%-12s %10s %10s %12s\n", "size", "cells", "spans", "ns/cell");
+
+    for (u32 s = 0; s < ARRAY_LEN(sizes); ++s) {
+        GameParams params = {
+            .width = sizes[s].width, .height = sizes[s].height, .num_bombs = sizes[s].num_bombs, .seed = 0
+        };
+        u64 mem_size = engine_mem_size(params.width, params.height);
+
+        mem_ctx_t ctx;
+        MEM_SCRATCH_START(ctx);
+        void *mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(mem_size, PAGE_SIZE));
+        if (!mem) {
+            log_error("Failed to alloc bench board");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+
+        Engine engine;
+        u64 spans = 0;
+        engine_init(&engine, 1, 0);
+        engine.span_fn = count_span;
+        engine.span_data = &spans;
+
+        u64 revealed = 0;
+        u64 ns = 0;
+        for (u32 g = 0; g < sizes[s].games; ++g) {
+            CHECK(engine_new_game(&engine, params, mem, mem_size), false);
+            // reveal the first empty cell
+            Board *board = &engine.board;
+            u64 idx = 0;
+            while (board_idx_to_cell(board, idx)->is_bomb || board_idx_to_cell(board, idx)->bombs_around > 0) {
+                idx++;
+            }
+            u64 start = platform_ticks_ns();
+            engine_reveal(&engine, (u32)(idx % board->width), (u32)(idx / board->width), 0);
+            ns += platform_ticks_ns() - start;
+            for (u64 i = 0; i < board->num_cells; ++i) {
+                revealed += board_idx_to_cell(board, i)->state == CELL_EXPLORED;
+            }
+        }
+
+        char size_str[32];
+        snprintf(size_str, sizeof(size_str), "%ux%u", params.width, params.height);
+        log_raw("%-12s %10lu %10lu %12.3f\n", size_str,
+                revealed / sizes[s].games, spans / sizes[s].games, ns_per(ns, revealed));
+
+        MEM_SCRATCH_END(ctx);
+    }
+
+    return true;
+}
+
+static bool bench_rng_calls()
+{
+    static const struct {
+        const char *name;
+        u64 bound; // 0 for raw rng_next()
+    } cases[] = {
+        { "next", 0 },
+        { "below 480", 480 },
+        { "below 2^32+1", (1ULL << 32) + 1 },
+        { "below 2^63+1", (1ULL << 63) + 1 },
+    };
+    const u64 iters = 1 << 26;
+
+    log_raw("rng: xoshiro256** (ns/call)\n");
+    for (u32 i = 0; i < ARRAY_LEN(cases); ++i) {
+        Rng rng;
+        rng_seed(&rng, BENCH_SEED);
+        u64 sum = 0;
+        u64 start = platform_ticks_ns();
+        if (cases[i].bound == 0) {
+            for (u64 n = 0; n < iters; ++n) {
+                sum += rng_next(&rng);
+            }
+        } else {
+            for (u64 n = 0; n < iters; ++n) {
+                sum += rng_below(&rng, cases[i].bound);
+            }
+        }
+        bench_sink += sum;
+        log_raw("%-14s %8.3f\n", cases[i].name, ns_per(platform_ticks_ns() - start, iters));
+    }
+
+    return true;
+}
+
+/*
+ * engine_new_game() at a range of densities, bomb placement plus counting
+ * Placement cost should stay flat right up to nearly full boards
+ */
+static bool bench_generate()
+{
+    static const u32 per_mille[] = { 10, 150, 500, 850, 999 };
+    const u32 width = 1024;
+    const u32 height = 1024;
+    const u32 games = 20;
+
+    log_raw("generate: engine_new_game() on %ux%u (ms/board)\n", width, height);
+    log_raw("%-10s %12s %12s\n", "density", "boxsum", "bitplanes");
+
+    u64 mem_size = engine_mem_size(width, height);
+    mem_ctx_t ctx;
+    MEM_SCRATCH_START(ctx);
+    void *mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(mem_size, PAGE_SIZE));
+    if (!mem) {
+        log_error("Failed to alloc bench board");
+        MEM_SCRATCH_END(ctx);
+        return false;
+    }
+
+    for (u32 d = 0; d < ARRAY_LEN(per_mille); ++d) {
+        GameParams params = {
+            .width = width, .height = height,
+            .num_bombs = (u32)((u64)width * height * per_mille[d] / 1000), .seed = 0
+        };
+        f64 results[2];
+        for (u32 k = 0; k < ARRAY_LEN(results); ++k) {
+            Engine engine;
+            engine_init(&engine, BENCH_SEED, k ? ENGINE_FLAG_BITPLANES : 0);
+            u64 start = platform_ticks_ns();
+            for (u32 g = 0; g < games; ++g) {
+                CHECK(engine_new_game(&engine, params, mem, mem_size), false);
+            }
+            results[k] = (f64)(platform_ticks_ns() - start) / games / 1e6;
+        }
+        char density_str[16];
+        snprintf(density_str, sizeof(density_str), "%.1f%%", per_mille[d] / 10.0);
+        log_raw("%-10s %12.3f %12.3f\n", density_str, results[0], results[1]);
+    }
+
+    MEM_SCRATCH_END(ctx);
+    return true;
+}
+
+/*
+ * solver_play() from the opening click of each difficulty
+ * A deduction is a cell found safe or a bomb; a check is a constraint
+ * taken off the work queue
+ */
+static bool bench_solver()
+{
+    static const struct {
+        const char *name;
+        GameParams params;
+    } difficulties[] = {
+        { "easy", game_easy },
+        { "medium", game_medium },
+        { "hard", game_hard },
+    };
+    const u32 games = 5000;
+
+    log_raw("solver: play from the opening click until stuck\n");
+    log_raw("%-10s %10s %14s %14s\n", "params", "won", "deductions/s", "checks/s");
+
+    for (u32 d = 0; d < ARRAY_LEN(difficulties); ++d) {
+        GameParams params = difficulties[d].params;
+        u64 engine_mem_sz = engine_mem_size(params.width, params.height);
+        u64 solver_mem_sz = solver_mem_size(params.width, params.height);
+
+        mem_ctx_t ctx;
+        MEM_SCRATCH_START(ctx);
+        void *engine_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(engine_mem_sz, 16));
+        void *solver_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(solver_mem_sz, 16));
+        if (!engine_mem || !solver_mem) {
+            log_error("Failed to alloc solver bench memory");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+
+        Engine engine;
+        Solver solver;
+        engine_init(&engine, BENCH_SEED, ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+        u64 won = 0;
+        u64 deductions = 0;
+        u64 checks = 0;
+        u64 ns = 0;
+        for (u32 g = 0; g < games; ++g) {
+            CHECK(engine_new_game(&engine, params, engine_mem, engine_mem_sz), false);
+            engine_reveal(&engine, params.width / 2, params.height / 2, 0);
+            u64 start = platform_ticks_ns();
+            won += solver_play(&solver, &engine, solver_mem, solver_mem_sz);
+            ns += platform_ticks_ns() - start;
+            deductions += solver.num_safe + solver.num_bombs;
+            checks += solver.num_checks;
+        }
+        f64 secs = (f64)ns / 1e9;
+        char won_str[16];
+        snprintf(won_str, sizeof(won_str), "%.1f%%", 100.0 * won / games);
+        log_raw("%-10s %10s %14.0f %14.0f\n", difficulties[d].name, won_str,
+                deductions / secs, checks / secs);
+
+        MEM_SCRATCH_END(ctx);
+    }
+
+    return true;
+}
+
+/*
+ * prob_compute() on hard boards wherever the solver gets stuck, guessing
+ * the safest cell each time until the game ends
+ */
+static bool bench_prob()
+{
+    GameParams params = game_hard;
+    const u32 games = 500;
+    const u64 max_nodes = 10000000;
+
+    log_raw("prob: bomb probabilities where the solver gets stuck on %ux%u, %u bombs\n",
+            params.width, params.height, params.num_bombs);
+
+    u64 engine_mem_sz = engine_mem_size(params.width, params.height);
+    u64 solver_mem_sz = solver_mem_size(params.width, params.height);
+    u64 prob_mem_sz = prob_mem_size(params.width, params.height);
+
+    mem_ctx_t ctx;
+    MEM_SCRATCH_START(ctx);
+    void *engine_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(engine_mem_sz, 16));
+    void *solver_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(solver_mem_sz, 16));
+    void *prob_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(prob_mem_sz, 16));
+    if (!engine_mem || !solver_mem || !prob_mem) {
+        log_error("Failed to alloc prob bench memory");
+        MEM_SCRATCH_END(ctx);
+        return false;
+    }
+
+    Engine engine;
+    Solver solver;
+    Prob prob;
+    engine_init(&engine, BENCH_SEED, ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+    u64 won = 0;
+    u64 positions = 0;
+    u64 gave_up = 0;
+    u64 frontier = 0;
+    u64 components = 0;
+    u32 largest = 0;
+    u64 nodes = 0;
+    u64 ns = 0;
+    for (u32 g = 0; g < games; ++g) {
+        CHECK(engine_new_game(&engine, params, engine_mem, engine_mem_sz), false);
+        engine_reveal(&engine, params.width / 2, params.height / 2, 0);
+        while (!solver_play(&solver, &engine, solver_mem, solver_mem_sz) &&
+               engine.status == ENGINE_PLAYING) {
+            u64 start = platform_ticks_ns();
+            bool ok = prob_compute(&prob, &engine.board, prob_mem, prob_mem_sz, max_nodes);
+            ns += platform_ticks_ns() - start;
+            positions++;
+            nodes += prob.num_nodes;
+            if (!ok) {
+                gave_up++;
+                break;
+            }
+            frontier += prob.num_frontier;
+            components += prob.num_components;
+            largest = MAX(largest, prob.largest_component);
+            u32 c, r;
+            if (!prob_safest(&prob, &engine.board, &c, &r)) {
+                break;
+            }
+            engine_reveal(&engine, c, r, 0);
+        }
+        won += engine.status == ENGINE_WON;
+    }
+    u64 solved = positions - gave_up;
+    log_raw("%-22s %10.1f%%\n", "won, guessing safest", 100.0 * won / games);
+    log_raw("%-22s %10llu\n", "positions", (unsigned long long)positions);
+    log_raw("%-22s %10llu\n", "over node budget", (unsigned long long)gave_up);
+    log_raw("%-22s %10.3f\n", "ms/position", (f64)ns / 1e6 / MAX(positions, 1));
+    log_raw("%-22s %10.0f\n", "nodes/position", (f64)nodes / MAX(positions, 1));
+    log_raw("%-22s %10.1f\n", "frontier cells", (f64)frontier / MAX(solved, 1));
+    log_raw("%-22s %10.1f\n", "components", (f64)components / MAX(solved, 1));
+    log_raw("%-22s %10u\n", "largest component", largest);
+
+    MEM_SCRATCH_END(ctx);
+    return true;
+}
+
+typedef struct {
+    JobSystem *jobs;
+    JobCounter *counter;
+    u32 depth;
+} TreeJob;
+
+static volatile u32 tree_jobs_run;
+
+// each job submits two children on its own counter, down to depth 0
+static void tree_job(void *data)
+{
+    TreeJob *job = (TreeJob *)data;
+    atomic_fetch_add_u32(&tree_jobs_run, 1);
+    if (job->depth == 0) {
+        return;
+    }
+    // children's data lives in their own slots of the tree, see bench_jobs()
+    TreeJob *children = job + 1;
+    u32 subtree = (1u << job->depth) - 1;
+    children[0] = (TreeJob){ job->jobs, job->counter, job->depth - 1 };
+    children[subtree] = (TreeJob){ job->jobs, job->counter, job->depth - 1 };
+    Job child_jobs[2] = {
+        { tree_job, &children[0] },
+        { tree_job, &children[subtree] },
+    };
+    job_submit(job->jobs, child_jobs, 2, job->counter);
+}
+
+/*
+ * Overhead of the job system: a binary tree of empty jobs, where every
+ * job spawns its children on the root's counter
+ */
+static bool bench_jobs()
+{
+    const u32 depth = 18;
+    const u32 runs = 10;
+    u32 num_threads = platform_num_cpus();
+    u32 num_jobs = (1u << (depth + 1)) - 1;
+
+    log_raw("jobs: binary tree of %u empty jobs, %u threads\n", num_jobs, num_threads);
+
+    // deepest path holds one job per level, plus a sibling per level
+    u32 capacity = 2 * depth + 2;
+    u64 jobs_mem_size = job_system_mem_size(num_threads, capacity);
+    mem_ctx_t ctx;
+    MEM_SCRATCH_START(ctx);
+    void *jobs_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(jobs_mem_size, 16));
+    // tree laid out in pre-order: a job's children are at +1 and +1 + subtree size
+    TreeJob *tree = mem_alloc_aligned(16, ALIGN_UP_POW_2((u64)num_jobs * sizeof(TreeJob), 16));
+    static JobSystem jobs;
+    if (!jobs_mem || !tree || !job_system_start(&jobs, num_threads, capacity, jobs_mem, jobs_mem_size)) {
+        log_error("Failed to set up job system");
+        MEM_SCRATCH_END(ctx);
+        return false;
+    }
+
+    u64 ns = 0;
+    for (u32 r = 0; r < runs; ++r) {
+        JobCounter counter = {0};
+        tree_jobs_run = 0;
+        tree[0] = (TreeJob){ &jobs, &counter, depth };
+        Job root = { tree_job, &tree[0] };
+        u64 start = platform_ticks_ns();
+        job_submit(&jobs, &root, 1, &counter);
+        job_wait(&jobs, &counter);
+        ns += platform_ticks_ns() - start;
+        CHECK_LOG(tree_jobs_run == num_jobs, false, "Ran %u jobs, expected %u", tree_jobs_run, num_jobs);
+    }
+    log_raw("%-10s %12.1f\n", "ns/job", ns_per(ns, (u64)num_jobs * runs));
+
+    job_system_stop(&jobs);
+    MEM_SCRATCH_END(ctx);
+    return true;
+}
+
+// no-guess boards from the standard difficulties, on every cpu
+static bool bench_noguess()
+{
+    static const struct {
+        const char *name;
+        GameParams params;
+    } difficulties[] = {
+        { "easy", game_easy },
+        { "medium", game_medium },
+        { "hard", game_hard },
+    };
+    const u32 boards = 10;
+    u32 num_threads = platform_num_cpus();
+
+    log_raw("noguess: generate no-guess boards, %u threads\n", num_threads);
+    log_raw("%-10s %12s %12s\n", "params", "ms/board", "tries/board");
+
+    for (u32 d = 0; d < ARRAY_LEN(difficulties); ++d) {
+        GameParams params = difficulties[d].params;
+        u64 mem_size = noguess_mem_size(params.width, params.height, num_threads);
+        u64 jobs_mem_size = job_system_mem_size(num_threads, num_threads);
+
+        mem_ctx_t ctx;
+        MEM_SCRATCH_START(ctx);
+        void *mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(mem_size, PAGE_SIZE));
+        void *jobs_mem = mem_alloc_aligned(16, ALIGN_UP_POW_2(jobs_mem_size, 16));
+        static JobSystem jobs;
+        if (!mem || !jobs_mem || !job_system_start(&jobs, num_threads, num_threads, jobs_mem, jobs_mem_size)) {
+            log_error("Failed to set up no-guess generator");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+
+        static NoGuessGen gen;
+        u64 tries = 0;
+        u64 start = platform_ticks_ns();
+        for (u32 b = 0; b < boards; ++b) {
+            params.seed = BENCH_SEED + b;
+            CHECK(noguess_start(&gen, &jobs, params, params.width / 2, params.height / 2,
+                                UINT64_MAX, num_threads, mem, mem_size), false);
+            u64 seed;
+            CHECK(noguess_finish(&gen, &seed), false);
+            tries += gen.found + 1;
+        }
+        f64 ms = (f64)(platform_ticks_ns() - start) / boards / 1e6;
+        log_raw("%-10s %12.3f %12.1f\n", difficulties[d].name, ms, (f64)tries / boards);
+
+        job_system_stop(&jobs);
+        MEM_SCRATCH_END(ctx);
+    }
+
+    return true;
+}
+
+/*
+ * Save an opened board with one write, then map it back and resume
+ * Resuming maps the file and checks its bitplanes a word at a time, so it
+ * grows with the board at 1/64 of a byte per cell per plane; reading the
+ * whole board afterwards pays for the cells' page faults instead
+ */
+static bool bench_snapshot()
+{
+    static const struct {
+        u32 width;
+        u32 height;
+    } sizes[] = {
+        { 256, 256 },
+        { 1024, 1024 },
+        { 4096, 4096 },
+    };
+    const char *path = "bench_snapshot.bsnap";
+
+    log_raw("snapshot: save, then map and resume an opened board\n");
+    log_raw("%-12s %12s %12s %12s %12s\n", "size", "MB", "save ms", "resume us", "touch ms");
+
+    for (u32 s = 0; s < ARRAY_LEN(sizes); ++s) {
+        GameParams params = {
+            .width = sizes[s].width, .height = sizes[s].height,
+            .num_bombs = sizes[s].width * sizes[s].height / 1000, .seed = BENCH_SEED
+        };
+        u64 mem_size = engine_mem_size(params.width, params.height);
+
+        mem_ctx_t ctx;
+        MEM_SCRATCH_START(ctx);
+        void *mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(mem_size, PAGE_SIZE));
+        void *load_mem = mem_alloc_aligned(PAGE_SIZE, ALIGN_UP_POW_2(mem_size, PAGE_SIZE));
+        if (!mem || !load_mem) {
+            log_error("Failed to alloc bench board");
+            MEM_SCRATCH_END(ctx);
+            return false;
+        }
+
+        static Engine engine;
+        engine_init(&engine, 1, ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+        CHECK(engine_new_game(&engine, params, mem, mem_size), false);
+        engine_reveal(&engine, params.width / 2, params.height / 2, 0);
+
+        u64 size;
+        u64 start = platform_ticks_ns();
+        EngineSnapshot *snapshot = engine_snapshot(&engine, 0, &size);
+        FILE *file = fopen(path, "wb");
+        CHECK_LOG(file, false, "Failed to open %s", path);
+        bool written = fwrite(snapshot, size, 1, file) == 1;
+        fclose(file);
+        CHECK_LOG(written, false, "Failed to write %s", path);
+        f64 save_ms = (f64)(platform_ticks_ns() - start) / 1e6;
+
+        static Engine loaded;
+        engine_init(&loaded, 1, ENGINE_FLAG_BITPLANES | ENGINE_FLAG_SAFE_FIRST_CLICK);
+        start = platform_ticks_ns();
+        u64 mapped_size;
+        void *mapped = platform_map_file(path, &mapped_size);
+        CHECK_LOG(mapped, false, "Failed to map %s", path);
+        CHECK(engine_snapshot_valid(mapped, mapped_size), false);
+        CHECK(engine_load_snapshot(&loaded, mapped, mapped_size, 0, load_mem, mem_size), false);
+        f64 resume_us = (f64)(platform_ticks_ns() - start) / 1e3;
+
+        start = platform_ticks_ns();
+        u64 explored = 0;
+        for (u64 i = 0; i < loaded.board.num_cells; ++i) {
+            explored += board_idx_to_cell(&loaded.board, i)->state == CELL_EXPLORED;
+        }
+        f64 touch_ms = (f64)(platform_ticks_ns() - start) / 1e6;
+        CHECK_LOG(explored == engine.board.num_safe_explored &&
+                  loaded.board.num_safe_explored == engine.board.num_safe_explored,
+                  false, "Resumed board doesn't match");
+
+        char size_str[32];
+        snprintf(size_str, sizeof(size_str), "%ux%u", params.width, params.height);
+        log_raw("%-12s %12.2f %12.3f %12.1f %12.3f\n", size_str, (f64)size / 1e6,
+                save_ms, resume_us, touch_ms);
+
+        platform_unmap_file(mapped, mapped_size);
+        remove(path);
+        MEM_SCRATCH_END(ctx);
+    }
+
+    return true;
+}
+
+static const Bench benches[] = {
+    { "counts", bench_counts },
+    { "opening", bench_opening },
+    { "generate", bench_generate },
+    { "rng", bench_rng_calls },
+    { "solver", bench_solver },
+    { "jobs", bench_jobs },
+    { "noguess", bench_noguess },
+    { "prob", bench_prob },
+    { "snapshot", bench_snapshot },
+};
+
+int main(int argc, char **argv)
+{
+    if (!platform_init() || !log_init()) {
+        return 1;
+    }
+    if (!mem_init(BENCH_MEM_BUDGET)) {
+        log_error("Failed to initialize memory subsystem");
+        return 1;
+    }
+    // fixed seed so every run benches the same boards
+    rng_seed(&bench_rng, BENCH_SEED);
+
+    bool ok = true;
+    for (u32 i = 0; i < ARRAY_LEN(benches); ++i) {
+        bool selected = argc <= 1;
+        for (int a = 1; a < argc; ++a) {
+            if (strcmp(argv[a], benches[i].name) == 0) {
+                selected = true;
+            }
+        }
+        if (!selected) {
+            continue;
+        }
+        if (!benches[i].fn()) {
+            log_error("Benchmark \"%s\" failed", benches[i].name);
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,793 @@
+/*
+ * Headless game server: hosts lots of concurrent games for bots over a
+ * compact binary protocol, from one thread with an epoll loop
+ * Usage: server [-u path | -p port] [-n max_sessions] [-s seed]
+ * Listens on a unix socket at path, or on 127.0.0.1:port (default 7777)
+ * Every connection is a session with one board at a time; its memory is
+ * a fixed slot from a pool, sized for the biggest board allowed
+ *
+ * Protocol, all little endian. Each frame is a u32 header, with the
+ * SERVER_MSG_* type in the top byte and the payload size in the low 24
+ * bits, then the payload. Requests:
+ *   NEW_GAME: u16 width, u16 height, u32 bombs, u64 seed (0 to pick one)
+ *     -> GAME: u64 seed, u16 width, u16 height, u32 bombs
+ *   REVEAL, FLAG: u16 col, u16 row (FLAG toggles)
+ *     -> DELTA: u8 ENGINE_* status, u8 SERVER_DELTA_* flags, i32 bombs left,
+ *               u32 count, then count cells of u32 index (r * width + c)
+ *               and u8 SERVER_CELL_* value
+ *   STATS: empty
+ *     -> STATS: u64 sessions, u64 games, u64 requests, u32 active sessions,
+ *               then for the last interval u32 sessions/s, u32 requests/s,
+ *               u32 p50 and u32 p99 request latency in us
+ * Anything wrong with a request gets ERROR: u8 SERVER_ERROR_*
+ * Requests are answered in order, so they can be pipelined
+ */
+// for accept4()
+#define _GNU_SOURCE
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+#include<signal.h>
+#include<unistd.h>
+#include<sys/epoll.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+
+#include"types.h"
+#include"platform.h"
+#include"log.h"
+#include"mem.h"
+#include"allocator.h"
+#include"engine.h"
+#include"rng.h"
+
+#define SERVER_MEM_BUDGET MiB(64ULL)
+#define SERVER_DEFAULT_PORT 7777
+#define SERVER_DEFAULT_SESSIONS 1024
+#define SERVER_DEFAULT_SEED 0x2545F4914F6CDD1DULL
+#define SERVER_MAX_SIDE 256
+#define SERVER_MAX_EVENTS 64
+#define SERVER_STATS_INTERVAL_MS 5000
+#define SERVER_IN_BUF_SIZE 4096
+#define SERVER_HEADER_SIZE 4
+#define SERVER_MAX_PAYLOAD ((1 << 24) - 1)
+
+enum {
+    SERVER_MSG_NEW_GAME = 1,
+    SERVER_MSG_REVEAL,
+    SERVER_MSG_FLAG,
+    SERVER_MSG_STATS,
+    // responses
+    SERVER_MSG_GAME = 0x81,
+    SERVER_MSG_DELTA,
+    SERVER_MSG_STATS_REPLY,
+    SERVER_MSG_ERROR = 0xFF
+};
+
+enum {
+    SERVER_ERROR_BAD_REQUEST = 1, // unknown type or wrong payload size
+    SERVER_ERROR_BAD_PARAMS, // board too big, too many bombs, cell out of range
+    SERVER_ERROR_NO_GAME // REVEAL or FLAG before NEW_GAME
+};
+
+// every cell not in the delta is unexplored; sent when the whole board changed
+#define SERVER_DELTA_FULL (1 << 0)
+
+// 0-8 explored, with that many bombs around
+enum {
+    SERVER_CELL_BOMB = 9, // explored bomb
+    SERVER_CELL_FLAGGED,
+    SERVER_CELL_UNEXPLORED
+};
+
+#define SERVER_DELTA_HEADER_SIZE (1 + 1 + 4 + 4)
+#define SERVER_DELTA_CELL_SIZE (4 + 1)
+#define SERVER_STATS_SIZE (3 * 8 + 5 * 4)
+// biggest response there is: a full delta of the biggest board
+#define SERVER_MAX_RESPONSE (SERVER_HEADER_SIZE + SERVER_DELTA_HEADER_SIZE + \
+                             SERVER_DELTA_CELL_SIZE * SERVER_MAX_SIDE * SERVER_MAX_SIDE)
+// room to queue small responses behind one that hasn't been sent yet
+#define SERVER_OUT_BUF_SIZE (2 * SERVER_MAX_RESPONSE)
+
+/*
+ * Latency histogram: 16 buckets per power of 2 of ns, so any value is
+ * within 1/16 of its bucket, from 1ns up to the whole u64 range
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct {
+    u64 counts[LATENCY_BUCKETS];
+    u64 total;
+    u64 max_ns;
+} LatencyHistogram;
+
+/*
+ * One per connection, at the start of its pool slot; the board memory
+ * and output buffer follow in the same slot
+ */
+typedef struct {
+    int fd;
+    bool has_game;
+    bool writing; // waiting on EPOLLOUT to send the rest of out
+    Engine engine;
+    void *board_mem;
+    u8 *out;
+    u32 out_len;
+    u32 out_pos;
+    u32 in_len;
+    u8 in[SERVER_IN_BUF_SIZE];
+} Session;
+
+typedef struct {
+    u64 sessions;
+    u64 games;
+    u64 requests;
+    u32 active;
+    LatencyHistogram latency;
+} ServerCounters;
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    struct PoolAllocator pool;
+    u64 board_mem_size;
+    Rng seed_rng;
+    ServerCounters total;
+    ServerCounters interval; // since last_stats_ms
+    u64 last_stats_ms;
+    // the last interval's rates, for STATS replies
+    u32 sessions_per_s;
+    u32 requests_per_s;
+    u32 p50_us;
+    u32 p99_us;
+} Server;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static u32 latency_bucket(u64 ns)
+{
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (u32)ns;
+    }
+    u32 e = 63 - CLZ_U64(ns); // >= LATENCY_SUB_BITS
+    u32 sub = (u32)(ns >> (e - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return ((e - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+// highest value that lands in bucket, so percentiles err on the slow side
+static u64 latency_bucket_max(u32 bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    u32 e = (bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+    u64 sub = bucket & (LATENCY_SUB_BUCKETS - 1);
+    u64 low = (LATENCY_SUB_BUCKETS + sub) << (e - LATENCY_SUB_BITS);
+    return low + ((u64)1 << (e - LATENCY_SUB_BITS)) - 1;
+}
+
+static void latency_add(LatencyHistogram *hist, u64 ns)
+{
+    hist->counts[latency_bucket(ns)]++;
+    hist->total++;
+    hist->max_ns = MAX(hist->max_ns, ns);
+}
+
+static u64 latency_percentile(const LatencyHistogram *hist, f64 p)
+{
+    if (hist->total == 0) {
+        return 0;
+    }
+    u64 rank = (u64)(p * (f64)(hist->total - 1)) + 1;
+    u64 seen = 0;
+    for (u32 i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            return MIN(latency_bucket_max(i), hist->max_ns);
+        }
+    }
+    return hist->max_ns;
+}
+
+static u16 get_u16(const u8 *p)
+{
+    return (u16)(p[0] | p[1] << 8);
+}
+
+static u32 get_u32(const u8 *p)
+{
+    return (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+static u64 get_u64(const u8 *p)
+{
+    return (u64)get_u32(p) | (u64)get_u32(p + 4) << 32;
+}
+
+static u8 *put_u8(u8 *p, u8 x)
+{
+    *p++ = x;
+    return p;
+}
+
+static u8 *put_u16(u8 *p, u16 x)
+{
+    *p++ = (u8)x;
+    *p++ = (u8)(x >> 8);
+    return p;
+}
+
+static u8 *put_u32(u8 *p, u32 x)
+{
+    for (u32 i = 0; i < 4; ++i) {
+        *p++ = (u8)(x >> (8 * i));
+    }
+    return p;
+}
+
+static u8 *put_u64(u8 *p, u64 x)
+{
+    p = put_u32(p, (u32)x);
+    return put_u32(p, (u32)(x >> 32));
+}
+
+// reserve a frame in the session's output; returns where the payload goes
+static u8 *begin_frame(Session *session, u8 type, u32 size)
+{
+    ASSERT(size <= SERVER_MAX_PAYLOAD);
+    ASSERT(session->out_len + SERVER_HEADER_SIZE + size <= SERVER_OUT_BUF_SIZE);
+
+    u8 *p = put_u32(&session->out[session->out_len], (u32)type << 24 | size);
+    session->out_len += SERVER_HEADER_SIZE + size;
+    return p;
+}
+
+static void send_error(Session *session, u8 error)
+{
+    put_u8(begin_frame(session, SERVER_MSG_ERROR, 1), error);
+}
+
+static u8 cell_value(Cell *cell)
+{
+    switch (cell->state) {
+        case CELL_EXPLORED:
+            return cell->is_bomb ? SERVER_CELL_BOMB : (u8)cell->bombs_around;
+        case CELL_FLAGGED:
+            return SERVER_CELL_FLAGGED;
+        default:
+            return SERVER_CELL_UNEXPLORED;
+    }
+}
+
+static u8 *put_cell(u8 *p, Board *board, u32 idx)
+{
+    p = put_u32(p, idx);
+    return put_u8(p, cell_value(board_idx_to_cell(board, idx)));
+}
+
+/*
+ * Send what changed since the last delta, straight from board.changes
+ * Cells can be listed more than once; the last value is the current one
+ */
+static void send_delta(Session *session)
+{
+    Engine *engine = &session->engine;
+    Board *board = &engine->board;
+    ChangeList *changes = &board->changes;
+    u32 num_cells = engine->params.width * engine->params.height;
+
+    u32 count = 0;
+    if (changes->all) {
+        for (u32 i = 0; i < num_cells; ++i) {
+            count += board_idx_to_cell(board, i)->state != CELL_UNEXPLORED;
+        }
+    } else {
+        count = changes->num;
+    }
+
+    u8 *p = begin_frame(session, SERVER_MSG_DELTA,
+                        SERVER_DELTA_HEADER_SIZE + count * SERVER_DELTA_CELL_SIZE);
+    p = put_u8(p, engine->status);
+    p = put_u8(p, changes->all ? SERVER_DELTA_FULL : 0);
+    p = put_u32(p, (u32)(i32)board->bombs_left);
+    p = put_u32(p, count);
+    if (changes->all) {
+        for (u32 i = 0; i < num_cells; ++i) {
+            if (board_idx_to_cell(board, i)->state != CELL_UNEXPLORED) {
+                p = put_cell(p, board, i);
+            }
+        }
+    } else {
+        for (u32 i = 0; i < changes->num; ++i) {
+            p = put_cell(p, board, changes->idxs[i]);
+        }
+    }
+    engine_clear_changes(engine);
+}
+
+static void handle_new_game(Server *server, Session *session, const u8 *payload, u32 size)
+{
+    if (size != 16) {
+        send_error(session, SERVER_ERROR_BAD_REQUEST);
+        return;
+    }
+    GameParams params = {0};
+    params.width = get_u16(payload);
+    params.height = get_u16(payload + 2);
+    params.num_bombs = get_u32(payload + 4);
+    params.seed = get_u64(payload + 8);
+    // at least one cell has to be free of bombs, for the first click
+    if (params.width == 0 || params.height == 0 ||
+        params.width > SERVER_MAX_SIDE || params.height > SERVER_MAX_SIDE ||
+        params.num_bombs >= params.width * params.height) {
+        send_error(session, SERVER_ERROR_BAD_PARAMS);
+        return;
+    }
+    if (params.seed == 0) {
+        params.seed = rng_next(&server->seed_rng);
+    }
+    // can't fail with a checked board and a slot sized for the biggest one
+    session->has_game = engine_new_game(&session->engine, params, session->board_mem,
+                                        server->board_mem_size);
+    ASSERT(session->has_game);
+    engine_clear_changes(&session->engine);
+    server->total.games++;
+    server->interval.games++;
+
+    u8 *p = begin_frame(session, SERVER_MSG_GAME, 16);
+    p = put_u64(p, params.seed);
+    p = put_u16(p, (u16)params.width);
+    p = put_u16(p, (u16)params.height);
+    put_u32(p, params.num_bombs);
+}
+
+static void handle_move(Session *session, u8 type, const u8 *payload, u32 size)
+{
+    if (size != 4) {
+        send_error(session, SERVER_ERROR_BAD_REQUEST);
+        return;
+    }
+    if (!session->has_game) {
+        send_error(session, SERVER_ERROR_NO_GAME);
+        return;
+    }
+    Engine *engine = &session->engine;
+    u32 c = get_u16(payload);
+    u32 r = get_u16(payload + 2);
+    if (c >= engine->params.width || r >= engine->params.height) {
+        send_error(session, SERVER_ERROR_BAD_PARAMS);
+        return;
+    }
+    if (type == SERVER_MSG_REVEAL) {
+        engine_reveal(engine, c, r, platform_ticks_ms());
+    } else {
+        engine_toggle_flag(engine, c, r);
+    }
+    // moves after the game is over just send an empty delta
+    send_delta(session);
+}
+
+static void handle_stats(Server *server, Session *session, u32 size)
+{
+    if (size != 0) {
+        send_error(session, SERVER_ERROR_BAD_REQUEST);
+        return;
+    }
+    u8 *p = begin_frame(session, SERVER_MSG_STATS_REPLY, SERVER_STATS_SIZE);
+    p = put_u64(p, server->total.sessions);
+    p = put_u64(p, server->total.games);
+    p = put_u64(p, server->total.requests);
+    p = put_u32(p, server->total.active);
+    p = put_u32(p, server->sessions_per_s);
+    p = put_u32(p, server->requests_per_s);
+    p = put_u32(p, server->p50_us);
+    put_u32(p, server->p99_us);
+}
+
+static void session_close(Server *server, Session *session)
+{
+    // closing the fd takes it out of the epoll set too
+    close(session->fd);
+    pool_free(&server->pool, session);
+    server->total.active--;
+}
+
+static bool session_watch(Server *server, Session *session, u32 events)
+{
+    struct epoll_event event = {0};
+    event.events = events;
+    event.data.ptr = session;
+    CHECK_LOG(epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, session->fd, &event) == 0, false,
+              "epoll_ctl failed: %s", strerror(errno));
+    return true;
+}
+
+/*
+ * Send as much of out as the socket takes. If it fills up, stop reading
+ * requests until it drains, so a bot that doesn't read can't make us
+ * buffer without limit
+ */
+static bool session_flush(Server *server, Session *session)
+{
+    while (session->out_pos < session->out_len) {
+        ssize_t n = send(session->fd, &session->out[session->out_pos],
+                         session->out_len - session->out_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!session->writing) {
+                    session->writing = true;
+                    return session_watch(server, session, EPOLLOUT);
+                }
+                return true;
+            }
+            return false;
+        }
+        session->out_pos += (u32)n;
+    }
+    session->out_pos = 0;
+    session->out_len = 0;
+    if (session->writing) {
+        session->writing = false;
+        return session_watch(server, session, EPOLLIN);
+    }
+    return true;
+}
+
+// true if a whole request is waiting in the input buffer
+static bool session_has_request(Session *session)
+{
+    if (session->in_len < SERVER_HEADER_SIZE) {
+        return false;
+    }
+    u32 size = get_u32(session->in) & SERVER_MAX_PAYLOAD;
+    return session->in_len - SERVER_HEADER_SIZE >= size;
+}
+
+/*
+ * Answer every complete request in the input buffer that there's room
+ * to reply to, then send the replies, until no whole requests are left
+ * or the socket stops taking replies
+ * Latency is from the read that brought the requests in (read_ns) to
+ * their replies being handed to the socket
+ */
+static bool session_process(Server *server, Session *session, u64 read_ns)
+{
+    do {
+        u32 pos = 0;
+        u32 num_requests = 0;
+        while (session->in_len - pos >= SERVER_HEADER_SIZE &&
+               SERVER_OUT_BUF_SIZE - session->out_len >= SERVER_MAX_RESPONSE) {
+            u32 header = get_u32(&session->in[pos]);
+            u8 type = (u8)(header >> 24);
+            u32 size = header & SERVER_MAX_PAYLOAD;
+            // no request is anywhere near this big; the stream is garbage
+            CHECK(size <= SERVER_IN_BUF_SIZE - SERVER_HEADER_SIZE, false);
+            if (session->in_len - pos < SERVER_HEADER_SIZE + size) {
+                break;
+            }
+            const u8 *payload = &session->in[pos + SERVER_HEADER_SIZE];
+            switch (type) {
+                case SERVER_MSG_NEW_GAME:
+                    handle_new_game(server, session, payload, size);
+                    break;
+                case SERVER_MSG_REVEAL:
+                case SERVER_MSG_FLAG:
+                    handle_move(session, type, payload, size);
+                    break;
+                case SERVER_MSG_STATS:
+                    handle_stats(server, session, size);
+                    break;
+                default:
+                    send_error(session, SERVER_ERROR_BAD_REQUEST);
+                    break;
+            }
+            pos += SERVER_HEADER_SIZE + size;
+            num_requests++;
+        }
+        memmove(session->in, &session->in[pos], session->in_len - pos);
+        session->in_len -= pos;
+
+        CHECK(session_flush(server, session), false);
+
+        if (num_requests > 0) {
+            u64 ns = platform_ticks_ns() - read_ns;
+            for (u32 i = 0; i < num_requests; ++i) {
+                latency_add(&server->total.latency, ns);
+                latency_add(&server->interval.latency, ns);
+            }
+            server->total.requests += num_requests;
+            server->interval.requests += num_requests;
+        }
+    // out drained, so there's room for whatever stopped the last pass
+    } while (!session->writing && session_has_request(session));
+    return true;
+}
+
+static bool session_read(Server *server, Session *session)
+{
+    // a full buffer always holds a whole request; answer it before reading more
+    if (session->in_len == SERVER_IN_BUF_SIZE) {
+        return session_process(server, session, platform_ticks_ns());
+    }
+    ssize_t n;
+    do {
+        n = recv(session->fd, &session->in[session->in_len],
+                 SERVER_IN_BUF_SIZE - session->in_len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (n == 0) {
+        return false;
+    }
+    session->in_len += (u32)n;
+    return session_process(server, session, platform_ticks_ns());
+}
+
+static void handle_session(Server *server, Session *session, u32 events)
+{
+    bool ok = !(events & (EPOLLERR | EPOLLHUP)) || (events & EPOLLIN);
+    if (ok && (events & EPOLLOUT)) {
+        u64 now = platform_ticks_ns();
+        // once drained, answer what was left waiting for room
+        ok = session_flush(server, session) &&
+             (session->writing || session_process(server, session, now));
+    }
+    if (ok && (events & EPOLLIN)) {
+        ok = session_read(server, session);
+    }
+    if (!ok) {
+        session_close(server, session);
+    }
+}
+
+static void accept_sessions(Server *server)
+{
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log_error("accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        Session *session = (Session *)pool_alloc(&server->pool);
+        if (!session) {
+            log_warn("Out of sessions, dropping connection");
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        // fails harmlessly on unix sockets
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        u8 *slot = (u8 *)session;
+        memset(session, 0, sizeof(*session));
+        session->fd = fd;
+        session->board_mem = slot + ALIGN_UP_POW_2(sizeof(Session), PAGE_SIZE);
+        session->out = (u8 *)session->board_mem + server->board_mem_size;
+        engine_init(&session->engine, rng_next(&server->seed_rng), ENGINE_FLAG_SAFE_FIRST_CLICK);
+
+        struct epoll_event event = {0};
+        event.events = EPOLLIN;
+        event.data.ptr = session;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            log_error("epoll_ctl failed: %s", strerror(errno));
+            close(fd);
+            pool_free(&server->pool, session);
+            continue;
+        }
+        server->total.sessions++;
+        server->interval.sessions++;
+        server->total.active++;
+    }
+}
+
+static void print_stats(const char *label, const ServerCounters *counters, f64 secs)
+{
+    log_info("%s: %u active, %llu sessions (%.1f/s), %llu games (%.1f/s), "
+             "%llu requests (%.1f/s), latency p50 %.1fus p99 %.1fus max %.1fus",
+             label, counters->active,
+             (unsigned long long)counters->sessions, counters->sessions / secs,
+             (unsigned long long)counters->games, counters->games / secs,
+             (unsigned long long)counters->requests, counters->requests / secs,
+             latency_percentile(&counters->latency, 0.5) / 1e3,
+             latency_percentile(&counters->latency, 0.99) / 1e3,
+             counters->latency.max_ns / 1e3);
+}
+
+static void update_stats(Server *server, u64 now_ms)
+{
+    u64 elapsed_ms = now_ms - server->last_stats_ms;
+    if (elapsed_ms < SERVER_STATS_INTERVAL_MS) {
+        return;
+    }
+    ServerCounters *interval = &server->interval;
+    f64 secs = elapsed_ms / 1e3;
+    server->sessions_per_s = (u32)(interval->sessions / secs);
+    server->requests_per_s = (u32)(interval->requests / secs);
+    server->p50_us = (u32)(latency_percentile(&interval->latency, 0.5) / 1000);
+    server->p99_us = (u32)(latency_percentile(&interval->latency, 0.99) / 1000);
+    if (interval->requests > 0 || interval->sessions > 0) {
+        interval->active = server->total.active;
+        print_stats("last interval", interval, secs);
+    }
+    memset(interval, 0, sizeof(*interval));
+    server->last_stats_ms = now_ms;
+}
+
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    CHECK_LOG(strlen(path) < sizeof(addr.sun_path), -1, "Socket path too long: %s", path);
+    strcpy(addr.sun_path, path);
+    // a stale socket from a previous run would make bind fail
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    CHECK_LOG(fd >= 0, -1, "socket failed: %s", strerror(errno));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        log_error("Failed to listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    log_info("Listening on %s", path);
+    return fd;
+}
+
+static int listen_tcp(u16 port)
+{
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    // localhost only; there's no auth, bots are meant to run alongside
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    CHECK_LOG(fd >= 0, -1, "socket failed: %s", strerror(errno));
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        log_error("Failed to listen on 127.0.0.1:%u: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    log_info("Listening on 127.0.0.1:%u", port);
+    return fd;
+}
+
+static bool server_start(Server *server, int listen_fd, u32 max_sessions, u64 seed)
+{
+    memset(server, 0, sizeof(*server));
+    server->listen_fd = listen_fd;
+    rng_seed(&server->seed_rng, seed);
+    server->board_mem_size = ALIGN_UP_POW_2(engine_mem_size(SERVER_MAX_SIDE, SERVER_MAX_SIDE),
+                                            PAGE_SIZE);
+    // pages are only touched as boards use them, so most of a slot stays unmapped
+    u64 slot_size = ALIGN_UP_POW_2(sizeof(Session), PAGE_SIZE) + server->board_mem_size +
+                    ALIGN_UP_POW_2(SERVER_OUT_BUF_SIZE, PAGE_SIZE);
+    CHECK_LOG(_pool_try_create(&server->pool, max_sessions, slot_size,
+                               platform_alloc_page_aligned, "session pool"),
+              false, "Failed to alloc %u sessions of %llu bytes", max_sessions,
+              (unsigned long long)slot_size);
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    CHECK_LOG(server->epoll_fd >= 0, false, "epoll_create1 failed: %s", strerror(errno));
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = NULL; // the listening socket
+    CHECK_LOG(epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == 0, false,
+              "epoll_ctl failed: %s", strerror(errno));
+    server->last_stats_ms = platform_ticks_ms();
+    return true;
+}
+
+static void server_run(Server *server)
+{
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    u64 start_ms = platform_ticks_ms();
+
+    while (running) {
+        u64 now_ms = platform_ticks_ms();
+        u64 wait_ms = server->last_stats_ms + SERVER_STATS_INTERVAL_MS - MIN(now_ms,
+                      server->last_stats_ms + SERVER_STATS_INTERVAL_MS);
+        int n = epoll_wait(server->epoll_fd, events, SERVER_MAX_EVENTS, (int)wait_ms);
+        if (n < 0 && errno != EINTR) {
+            log_error("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            Session *session = (Session *)events[i].data.ptr;
+            if (!session) {
+                accept_sessions(server);
+            } else {
+                handle_session(server, session, events[i].events);
+            }
+        }
+        update_stats(server, platform_ticks_ms());
+    }
+    f64 secs = MAX(platform_ticks_ms() - start_ms, 1) / 1e3;
+    print_stats("total", &server->total, secs);
+}
+
+static void usage()
+{
+    log_raw("Usage: server [-u path | -p port] [-n max_sessions] [-s seed]\n"
+            "Listens on a unix socket at path, or 127.0.0.1:port (default: port %u)\n",
+            SERVER_DEFAULT_PORT);
+}
+
+int main(int argc, char **argv)
+{
+    if (!platform_init() || !log_init()) {
+        return 1;
+    }
+    if (!mem_init(SERVER_MEM_BUDGET)) {
+        log_error("Failed to initialize memory subsystem");
+        return 1;
+    }
+
+    const char *path = NULL;
+    u32 port = SERVER_DEFAULT_PORT;
+    u32 max_sessions = SERVER_DEFAULT_SESSIONS;
+    u64 seed = SERVER_DEFAULT_SEED;
+
+    for (int a = 1; a < argc; ++a) {
+        const char *arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (strcmp(arg, "-u") == 0 && has_value) {
+            path = argv[++a];
+        } else if (strcmp(arg, "-p") == 0 && has_value) {
+            port = (u32)strtoul(argv[++a], NULL, 0);
+        } else if (strcmp(arg, "-n") == 0 && has_value) {
+            max_sessions = (u32)strtoul(argv[++a], NULL, 0);
+        } else if (strcmp(arg, "-s") == 0 && has_value) {
+            seed = strtoull(argv[++a], NULL, 0);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (port == 0 || port > UINT16_MAX || max_sessions == 0) {
+        usage();
+        return 1;
+    }
+
+    struct sigaction action = {0};
+    action.sa_handler = on_signal;
+    // no SA_RESTART, so epoll_wait returns and the loop sees running == 0
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int listen_fd = path ? listen_unix(path) : listen_tcp((u16)port);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    static Server server;
+    if (!server_start(&server, listen_fd, max_sessions, seed)) {
+        return 1;
+    }
+    server_run(&server);
+
+    close(listen_fd);
+    if (path) {
+        unlink(path);
+    }
+    return 0;
+}